@@ -13,45 +13,628 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdarg.h>
 #include <ctype.h>
 #include <time.h>
+#include <math.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#ifdef _WIN32
+#include <windows.h>
+#define strcasecmp _stricmp
+#define strncasecmp _strnicmp
+#else
+#include <unistd.h>
+#include <strings.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 
 #define SIZE 8
-#define MAX_MOVES 1024
+#define MAX_MOVES 256
 #define MAX_HISTORY 4096
 
-/* ===== State ===== */
-char board[SIZE][SIZE];
-int lastFromR=-1, lastFromC=-1, lastToR=-1, lastToC=-1;
-int halfmoveClock = 0; // resets on pawn move or capture
-int fullmoveNumber = 1;
-int gameOver = 0;
+/* ===== State =====
+   Nothing about a game lives in globals: a Position holds everything the rules
+   need, a Game adds the presentation state of one interactive session. Both are
+   passed explicitly, so any number of games can run side by side. */
+typedef unsigned long long U64;
 
-// castling flags
-int whiteKingMoved = 0, blackKingMoved = 0;
-int whiteRookA_Moved = 0, whiteRookH_Moved = 0;
-int blackRookA_Moved = 0, blackRookH_Moved = 0;
-
-// en-passant target (square where pawn would land if capturing en-passant)
-int epR = -1, epC = -1;
-
-// move history
-char history[MAX_HISTORY][32];
-int historyCount = 0;
+typedef struct {
+    char board[SIZE][SIZE];  // mirror of the bitboards, written only via setSquare
+    U64 pieceBB[12];         // one set per piece type and color
+    U64 occBB[3];            // 0 = white, 1 = black, 2 = all; set bits double as per-side piece lists
+    signed char kingSq[2];   // 0 = white, 1 = black, -1 = no king on the board
+    int halfmoveClock;       // resets on pawn move or capture
+    int fullmoveNumber;
+    // castling flags
+    int whiteKingMoved, blackKingMoved;
+    int whiteRookA_Moved, whiteRookH_Moved;
+    int blackRookA_Moved, blackRookH_Moved;
+    // en-passant target (square where pawn would land if capturing en-passant)
+    int epR, epC;
+    U64 key;                 // Zobrist key, kept incrementally by setSquare / makeMoveStruct
+    // evaluation terms, kept incrementally by setSquare (white minus black)
+    int mg, eg;              // material + piece-square, middlegame / endgame
+    int phase;               // 24 = all minor/major pieces on board, 0 = pawn ending
+    unsigned char pieceCount[12];
+} Position;
 
+// a move plus everything unmakeMove needs to restore the position exactly
 typedef struct {
     int fr, fc, tr, tc;
+    char promo;              // promotion piece or 0, set by the caller
     char movedPiece;
     char capturedPiece;
     int prevHalfmoveClock;
-    // flags snapshot (not used heavily here but kept for completeness)
+    // undo snapshot, filled in by makeMoveStruct
+    signed char prevEpR, prevEpC;
+    unsigned char prevCastle; // packed *_Moved flags
+    unsigned char flags;      // MF_* below
+    U64 prevKey;
 } Move;
 
+#define MF_EP     1
+#define MF_CASTLE 2
+
+/* A packed move is 16 bits: from (0-5) | to (6-11) | promotion piece (12-13,
+   index into "nbrq") | type (14-15). Move lists, the game record, the PV and the
+   transposition table all store this form; text is produced only for display. */
+typedef unsigned short PackedMove;
+enum { MT_NORMAL, MT_PROMO, MT_EP, MT_CASTLE };
+#define NO_MOVE 0
+#define PACK_MOVE(from,to,type,promo) ((PackedMove)((from) | (to)<<6 | (promo)<<12 | (type)<<14))
+#define PM_FROM(m)  ((m) & 63)
+#define PM_TO(m)    (((m)>>6) & 63)
+#define PM_PROMO(m) (((m)>>12) & 3)
+#define PM_TYPE(m)  ((m)>>14)
+
+typedef struct {
+    Position pos;
+    Position startPos;        // startPos + moves[] is an exact, replayable record of the game
+    char startSide;           // side to move in startPos
+    int lastFromR, lastFromC, lastToR, lastToC;
+    int gameOver;
+    PackedMove moves[MAX_HISTORY];
+    Move undo[MAX_HISTORY];   // undo record of moves[i]: the stack takeback pops
+    U64 keys[MAX_HISTORY+1];  // keys[i] = position key after i plies, for repetition checks
+    int historyCount;
+    char shown[SIZE][SIZE];   // board as last drawn in diff mode; shownValid = 0 redraws every square
+    U64 shownHl;              // highlighted squares of that frame
+    int shownValid;
+} Game;
+
 /* ===== Utility ===== */
 int colIndex(char c) { return c - 'a'; }
 int validPos(int r,int c) { return r>=0 && r<8 && c>=0 && c<8; }
 
-void initBoard() {
+// a whole file mapped read-only (opening books, endgame tables)
+typedef struct {
+    const unsigned char *data; size_t size;
+#ifdef _WIN32
+    HANDLE file, map;
+#endif
+} MappedFile;
+
+void unmapFile(MappedFile *m) {
+    if (!m->data) return;
+#ifdef _WIN32
+    UnmapViewOfFile(m->data); CloseHandle(m->map); CloseHandle(m->file);
+#else
+    munmap((void*)m->data, m->size);
+#endif
+    m->data = NULL; m->size = 0;
+}
+
+// returns 0 (and leaves m unmapped) when path cannot be opened or is empty
+int mapFile(MappedFile *m, const char *path) {
+    unmapFile(m);
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file==INVALID_HANDLE_VALUE) return 0;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart<=0) { CloseHandle(file); return 0; }
+    HANDLE map = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    const void *data = map ? MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0) : NULL;
+    if (!data) { if (map) CloseHandle(map); CloseHandle(file); return 0; }
+    m->file = file; m->map = map; m->data = data; m->size = (size_t)size.QuadPart;
+#else
+    int fd = open(path, O_RDONLY); struct stat st;
+    if (fd<0) return 0;
+    if (fstat(fd, &st)<0 || st.st_size<=0) { close(fd); return 0; }
+    void *data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); // the mapping keeps the file alive
+    if (data==MAP_FAILED) return 0;
+    m->data = data; m->size = (size_t)st.st_size;
+#endif
+    return 1;
+}
+
+/* ===== Statistics =====
+   Hot-path counters (move generation, attack tests, make/unmake, search nodes,
+   transposition table) and the thinking time of every engine move, shown by the
+   "stats" command and written as JSON at exit with --stats-json. Each thread
+   counts into its own block, found through a thread-local pointer, so counting
+   never contends; the blocks are summed only when a report is asked for. The
+   block of a finished thread passes to the next new one and keeps its totals.
+   Build with -DCATUR_NO_STATS to compile the counting out. */
+enum { ST_GEN_CALLS, ST_GEN_MOVES, ST_ATTACK_TESTS, ST_CHECK_TESTS, ST_MAKES, ST_UNMAKES, ST_NODES, ST_TT_PROBES, ST_TT_HITS, ST_TT_CUTOFFS, ST_COUNT };
+const char *statNames[ST_COUNT] = {"gen_calls","gen_moves","square_attacked_calls","check_tests","makes","unmakes","search_nodes","tt_probes","tt_hits","tt_cutoffs"};
+
+#ifndef CATUR_NO_STATS
+typedef struct StatBlock { _Atomic long long v[ST_COUNT]; atomic_int inUse; struct StatBlock *next; } StatBlock;
+StatBlock *statBlocks;       // every block handed out so far
+pthread_mutex_t statLock = PTHREAD_MUTEX_INITIALIZER;
+pthread_key_t statKey; pthread_once_t statKeyOnce = PTHREAD_ONCE_INIT;
+_Thread_local StatBlock *myStats;
+int *moveTimes; int moveTimeCount, moveTimeCap; // every engine thinking time (ms), game after game, under statLock
+int *gameStarts; int gameCount, gameCap;        // where each game's times begin in moveTimes
+
+void statRelease(void *b) { atomic_store(&((StatBlock*)b)->inUse, 0); }
+void statMakeKey(void) { pthread_key_create(&statKey, statRelease); }
+
+// first count by this thread: take over the block of a finished thread, or add one
+StatBlock *statAttach(void) {
+    static StatBlock spare;  // out of memory: counts go nowhere
+    pthread_once(&statKeyOnce, statMakeKey);
+    pthread_mutex_lock(&statLock);
+    StatBlock *b = statBlocks;
+    while (b && atomic_load(&b->inUse)) b = b->next;
+    if (!b && (b = calloc(1, sizeof(StatBlock)))) { b->next = statBlocks; statBlocks = b; }
+    if (b) atomic_store(&b->inUse, 1);
+    pthread_mutex_unlock(&statLock);
+    if (!b) b = &spare;
+    else pthread_setspecific(statKey, b);
+    return myStats = b;
+}
+
+// single writer per block: a plain load + store, like the node counters
+#define STAT_ADD(i,n) do { StatBlock *sb_ = myStats ? myStats : statAttach(); \
+    atomic_store_explicit(&sb_->v[i], atomic_load_explicit(&sb_->v[i], memory_order_relaxed)+(n), memory_order_relaxed); } while (0)
+
+void statTotals(long long *out) {
+    memset(out, 0, ST_COUNT*sizeof(long long));
+    pthread_mutex_lock(&statLock);
+    for (StatBlock *b=statBlocks; b; b=b->next) for (int i=0;i<ST_COUNT;i++) out[i] += atomic_load_explicit(&b->v[i], memory_order_relaxed);
+    pthread_mutex_unlock(&statLock);
+}
+
+// grow *a to hold need ints; 0 when out of memory
+static int statReserve(int **a, int *cap, int need) {
+    if (need<=*cap) return 1;
+    int c = *cap ? *cap : 256; while (c<need) c *= 2;
+    int *t = realloc(*a, c*sizeof(int));
+    if (!t) return 0;
+    *a = t; *cap = c; return 1;
+}
+
+// start a game at the end of moveTimes; an empty last game is reused. Caller holds statLock
+static int statOpenGame(void) {
+    if (gameCount && gameStarts[gameCount-1]==moveTimeCount) return 1;
+    if (!statReserve(&gameStarts, &gameCap, gameCount+1)) return 0;
+    gameStarts[gameCount++] = moveTimeCount; return 1;
+}
+
+// one engine move of the current game
+void statMoveTime(long long ms) {
+    pthread_mutex_lock(&statLock);
+    if ((gameCount || statOpenGame()) && statReserve(&moveTimes, &moveTimeCap, moveTimeCount+1)) moveTimes[moveTimeCount++] = (int)ms;
+    pthread_mutex_unlock(&statLock);
+}
+
+void statNewGame(void) { pthread_mutex_lock(&statLock); statOpenGame(); pthread_mutex_unlock(&statLock); }
+
+// a finished game's times in one go (self-play games run concurrently)
+void statGameMoveTimes(const int *t, int n) {
+    pthread_mutex_lock(&statLock);
+    if (n>0 && statOpenGame() && statReserve(&moveTimes, &moveTimeCap, moveTimeCount+n)) { memcpy(moveTimes+moveTimeCount, t, n*sizeof(int)); moveTimeCount += n; }
+    pthread_mutex_unlock(&statLock);
+}
+
+int statGameCount(void) { pthread_mutex_lock(&statLock); int n = gameCount; pthread_mutex_unlock(&statLock); return n; }
+
+int cmpInt(const void *a, const void *b) { return (*(const int*)a > *(const int*)b) - (*(const int*)a < *(const int*)b); }
+
+// thinking-time summary of game (-1 = all games): count, mean, p50, p90, p99, max (ms)
+void statMoveSummary(int game, long long out[6]) {
+    memset(out, 0, 6*sizeof(long long));
+    pthread_mutex_lock(&statLock);
+    int from = game<0 ? 0 : game<gameCount ? gameStarts[game] : moveTimeCount;
+    int to = game<0 || game+1>=gameCount ? moveTimeCount : gameStarts[game+1];
+    int n = to-from, *t = n>0 ? malloc(n*sizeof(int)) : NULL;
+    if (t) memcpy(t, moveTimes+from, n*sizeof(int));
+    pthread_mutex_unlock(&statLock);
+    if (!t) return;
+    qsort(t, n, sizeof(int), cmpInt);
+    long long sum = 0; for (int i=0;i<n;i++) sum += t[i];
+    out[0] = n; out[1] = sum/n; out[2] = t[(n-1)*50/100]; out[3] = t[(n-1)*90/100]; out[4] = t[(n-1)*99/100]; out[5] = t[n-1];
+    free(t);
+}
+
+void printStats(FILE *f) {
+    long long v[ST_COUNT], mt[6]; int games = statGameCount();
+    statTotals(v); statMoveSummary(games ? games-1 : 0, mt);
+    fprintf(f, "=== Statistik ===\n");
+    for (int i=0;i<ST_COUNT;i++) fprintf(f, "%-22s %lld\n", statNames[i], v[i]);
+    if (v[ST_GEN_CALLS]) fprintf(f, "Rata-rata langkah per generasi: %.1f\n", (double)v[ST_GEN_MOVES]/v[ST_GEN_CALLS]);
+    if (v[ST_TT_PROBES]) fprintf(f, "TT hit: %.1f%%, cutoff: %.1f%%\n", 100.0*v[ST_TT_HITS]/v[ST_TT_PROBES], 100.0*v[ST_TT_CUTOFFS]/v[ST_TT_PROBES]);
+    if (mt[0]) fprintf(f, "Waktu berpikir komputer (partai ini, %lld langkah): rata-rata %lld ms, p50 %lld, p90 %lld, p99 %lld, maks %lld ms\n", mt[0], mt[1], mt[2], mt[3], mt[4], mt[5]);
+    else fprintf(f, "Komputer belum melangkah di partai ini.\n");
+}
+
+static void jsonMoveSummary(FILE *f, const long long mt[6]) {
+    fprintf(f, "{\"count\": %lld, \"mean\": %lld, \"p50\": %lld, \"p90\": %lld, \"p99\": %lld, \"max\": %lld}", mt[0], mt[1], mt[2], mt[3], mt[4], mt[5]);
+}
+
+// move_ms covers every game; games has one summary per game that recorded a move
+void writeStatsJson(FILE *f) {
+    long long v[ST_COUNT], mt[6]; int games = statGameCount(), first = 1;
+    statTotals(v); statMoveSummary(-1, mt);
+    fprintf(f, "{\"enabled\": true, \"counters\": {");
+    for (int i=0;i<ST_COUNT;i++) fprintf(f, "%s\"%s\": %lld", i ? ", " : "", statNames[i], v[i]);
+    fprintf(f, "}, \"move_ms\": "); jsonMoveSummary(f, mt);
+    fprintf(f, ", \"games\": [");
+    for (int i=0;i<games;i++) {
+        statMoveSummary(i, mt);
+        if (!mt[0]) continue;
+        fprintf(f, "%s", first ? "" : ", "); jsonMoveSummary(f, mt); first = 0;
+    }
+    fprintf(f, "]}\n");
+}
+#else
+#define STAT_ADD(i,n) ((void)0)
+void statMoveTime(long long ms) { (void)ms; }
+void statNewGame(void) {}
+void statGameMoveTimes(const int *t, int n) { (void)t; (void)n; }
+void printStats(FILE *f) { fprintf(f, "Statistik dinonaktifkan saat kompilasi (CATUR_NO_STATS).\n"); }
+void writeStatsJson(FILE *f) { fprintf(f, "{\"enabled\": false}\n"); }
+#endif
+
+/* ===== Packed move text (rendered only when displayed) ===== */
+// coordinate notation as used by perft and the engine output: "e2e4", "e7e8q"
+void moveToStr(PackedMove pm, char *out) {
+    int from = PM_FROM(pm), to = PM_TO(pm);
+    out[0]='a'+from%8; out[1]='0'+(8-from/8); out[2]='a'+to%8; out[3]='0'+(8-to/8);
+    out[4] = PM_TYPE(pm)==MT_PROMO ? "nbrq"[PM_PROMO(pm)] : '\0'; out[5]='\0';
+}
+
+// same move with another promotion piece (letter in any case, e.g. 'Q' or 'n')
+PackedMove withPromotion(PackedMove pm, char piece) {
+    const char *p = strchr("nbrq", tolower((unsigned char)piece));
+    return PACK_MOVE(PM_FROM(pm), PM_TO(pm), MT_PROMO, p ? (int)(p-"nbrq") : 3);
+}
+
+// display form for the move history: "e2-e4", "e7-e8=Q", "O-O"
+void formatMove(PackedMove pm, char *out, size_t len) {
+    int from = PM_FROM(pm), to = PM_TO(pm);
+    if (PM_TYPE(pm)==MT_CASTLE) { snprintf(out, len, "%s", to%8==6 ? "O-O" : "O-O-O"); return; }
+    snprintf(out, len, "%c%d-%c%d", 'a'+from%8, 8-from/8, 'a'+to%8, 8-to/8);
+    if (PM_TYPE(pm)==MT_PROMO) snprintf(out+5, len>5 ? len-5 : 0, "=%c", "NBRQ"[PM_PROMO(pm)]);
+}
+
+/* ===== Bitboards =====
+   Square index sq = r*8 + c, same orientation as board[r][c] (a8 = 0, h1 = 63).
+   The bitboards are the primary position; board[][] is a mirror kept for
+   printBoard and piece-on-square lookups, and must only be written via setSquare. */
+enum { WP, WN, WB, WR, WQ, WK, BP, BN, BB, BR, BQ, BK };
+
+#define SQ(r,c) ((r)*8+(c))
+#define BIT(sq) (1ULL<<(sq))
+#define LSB(b) __builtin_ctzll(b)
+#define POPCNT(b) __builtin_popcountll(b)
+
+int pieceIndex(char p) {
+    switch(p){case 'P': return WP; case 'N': return WN; case 'B': return WB; case 'R': return WR; case 'Q': return WQ; case 'K': return WK;
+              case 'p': return BP; case 'n': return BN; case 'b': return BB; case 'r': return BR; case 'q': return BQ; case 'k': return BK; default: return -1;}
+}
+
+// Zobrist keys (filled by initZobrist): pieces, castling-rights mask, ep file, side to move
+U64 zobPiece[12][64], zobCastle[16], zobEp[8], zobSide;
+// material + piece-square values per piece and square, signed white-positive (filled by initEval)
+int psqMg[12][64], psqEg[12][64];
+const int phaseInc[12] = {0,1,1,2,4,0, 0,1,1,2,4,0};
+
+// place piece p ('.' to clear) on (r,c), keeping board[][], the bitboards and the key in sync
+void setSquare(Position *pos, int r,int c,char p) {
+    int sq = SQ(r,c); int old = pieceIndex(pos->board[r][c]);
+    if (old>=0) {
+        pos->pieceBB[old] &= ~BIT(sq); pos->occBB[old<6?0:1] &= ~BIT(sq); pos->occBB[2] &= ~BIT(sq); pos->key ^= zobPiece[old][sq];
+        pos->mg -= psqMg[old][sq]; pos->eg -= psqEg[old][sq]; pos->phase -= phaseInc[old]; pos->pieceCount[old]--;
+        // a moving king is placed on its target first, so only clear if it still points here
+        if ((old==WK || old==BK) && pos->kingSq[old==BK]==sq) pos->kingSq[old==BK] = -1;
+    }
+    pos->board[r][c] = p;
+    int idx = pieceIndex(p);
+    if (idx>=0) {
+        pos->pieceBB[idx] |= BIT(sq); pos->occBB[idx<6?0:1] |= BIT(sq); pos->occBB[2] |= BIT(sq); pos->key ^= zobPiece[idx][sq];
+        pos->mg += psqMg[idx][sq]; pos->eg += psqEg[idx][sq]; pos->phase += phaseInc[idx]; pos->pieceCount[idx]++;
+        if (idx==WK || idx==BK) pos->kingSq[idx==BK] = (signed char)sq;
+    }
+}
+
+// rebuild all bitboards and evaluation terms from board[][] (after bulk setup such as initBoard / loadFen)
+void syncBitboards(Position *pos) {
+    memset(pos->pieceBB, 0, sizeof(pos->pieceBB)); memset(pos->occBB, 0, sizeof(pos->occBB));
+    memset(pos->pieceCount, 0, sizeof(pos->pieceCount)); pos->mg = pos->eg = pos->phase = 0;
+    pos->kingSq[0] = pos->kingSq[1] = -1;
+    for (int r=0;r<8;r++) for (int c=0;c<8;c++) {
+        int idx = pieceIndex(pos->board[r][c]), sq = SQ(r,c); if (idx<0) continue;
+        pos->pieceBB[idx] |= BIT(sq); pos->occBB[idx<6?0:1] |= BIT(sq); pos->occBB[2] |= BIT(sq);
+        pos->mg += psqMg[idx][sq]; pos->eg += psqEg[idx][sq]; pos->phase += phaseInc[idx]; pos->pieceCount[idx]++;
+        if (idx==WK || idx==BK) pos->kingSq[idx==BK] = (signed char)sq;
+    }
+}
+
+/* ===== Precomputed attack tables ===== */
+U64 knightAtt[64], kingAtt[64];
+U64 pawnAtt[2][64];      // [0] = squares a white pawn on sq attacks, [1] = black
+U64 betweenBB[64][64];   // squares strictly between two aligned squares, else 0
+U64 lineBB[64][64];      // whole board line through two aligned squares, else 0
+
+// sliding lookups: magic multiply (or PEXT when built with -DUSE_PEXT -mbmi2)
+typedef struct { U64 mask, magic; U64 *attacks; int shift; } Magic;
+Magic rookMagic[64], bishopMagic[64];
+U64 rookTable[102400], bishopTable[5248];
+
+#if defined(USE_PEXT)
+#include <immintrin.h>
+#define MAGIC_INDEX(m,occ) _pext_u64((occ),(m)->mask)
+#else
+#define MAGIC_INDEX(m,occ) ((((occ)&(m)->mask)*(m)->magic)>>(m)->shift)
+#endif
+
+static inline U64 rookAttacks(int sq, U64 occ) { const Magic *m=&rookMagic[sq]; return m->attacks[MAGIC_INDEX(m,occ)]; }
+static inline U64 bishopAttacks(int sq, U64 occ) { const Magic *m=&bishopMagic[sq]; return m->attacks[MAGIC_INDEX(m,occ)]; }
+
+// ray walk used only while building the tables
+U64 slidingAttackSlow(int sq, U64 occ, const int dr[4], const int dc[4]) {
+    U64 att = 0; int r = sq/8, c = sq%8;
+    for (int d=0;d<4;d++) {
+        int rr=r+dr[d], cc=c+dc[d];
+        while (validPos(rr,cc)) { att |= BIT(SQ(rr,cc)); if (occ & BIT(SQ(rr,cc))) break; rr+=dr[d]; cc+=dc[d]; }
+    }
+    return att;
+}
+
+const int ROOK_DR[4]={-1,1,0,0}, ROOK_DC[4]={0,0,-1,1};
+const int BISHOP_DR[4]={-1,-1,1,1}, BISHOP_DC[4]={-1,1,-1,1};
+
+// magics found offline with the search below, so startup does not have to search
+const U64 ROOK_MAGICS[64] = {
+    0x0480046281400010ULL, 0x1040100040002002ULL, 0x8780200008300180ULL, 0x8880060800100080ULL,
+    0x8200020104100820ULL, 0x0200100104020008ULL, 0x0480010000800200ULL, 0x4E00008201005024ULL,
+    0x1000800080400020ULL, 0x0080401000402001ULL, 0x0104802002801000ULL, 0x4401808010003800ULL,
+    0x8001801801140080ULL, 0x0002000810020004ULL, 0x0002004402004108ULL, 0x0011800300004180ULL,
+    0x4540008020408006ULL, 0x0000404000201001ULL, 0x7D10010100200040ULL, 0x1380808008001002ULL,
+    0x4408010005000810ULL, 0x0012008080020400ULL, 0x0002040002081001ULL, 0x102202000444810CULL,
+    0x0100400080208001ULL, 0x4800400140201002ULL, 0x1060100080200082ULL, 0x00E0100080080084ULL,
+    0x0001000500080010ULL, 0x4002000600100419ULL, 0x0000020400104108ULL, 0x4805800080004100ULL,
+    0x0280002001400240ULL, 0xA010002000400040ULL, 0x0430124103002000ULL, 0x02820A0042002010ULL,
+    0x0131001005000800ULL, 0x0C01000401000208ULL, 0x8102010204001008ULL, 0x0802004092001104ULL,
+    0x4C40004020808002ULL, 0x4410500420024000ULL, 0x00C0100020008080ULL, 0x0000100008008080ULL,
+    0x0004008008008004ULL, 0x0802000804010100ULL, 0x0001011002040008ULL, 0x00330044008A0009ULL,
+    0x1000400280022480ULL, 0x0840004880200880ULL, 0x0000200080100080ULL, 0x8044080480100080ULL,
+    0x0100040080080080ULL, 0x2084010002004040ULL, 0x0040020850410400ULL, 0x000900A114084200ULL,
+    0x00008002204A1101ULL, 0x0801004000201081ULL, 0x4300C0200011000DULL, 0x1385002008041001ULL,
+    0x140A0084A0181032ULL, 0x040300040018020DULL, 0x0000280201009004ULL, 0x0003000208902041ULL
+};
+const U64 BISHOP_MAGICS[64] = {
+    0x48081010008A2A80ULL, 0x0102C40404821100ULL, 0x0021480880800180ULL, 0x0004504201800180ULL,
+    0x0004042111103108ULL, 0xC242086208200204ULL, 0x1000640220900350ULL, 0x10008020901008C4ULL,
+    0x0000312208080880ULL, 0x0220021002009900ULL, 0x0802120C24082080ULL, 0x0044110404810900ULL,
+    0x40002848400A0000ULL, 0x2020409004201400ULL, 0x1000020804028830ULL, 0x0008002414040491ULL,
+    0x0008403429080820ULL, 0x0108001090209080ULL, 0x6424084043060030ULL, 0x88A8103404208810ULL,
+    0x0014004210140404ULL, 0x800A000101010148ULL, 0x0001004411180200ULL, 0x1000408101080121ULL,
+    0x0008068340104200ULL, 0x0112110008110800ULL, 0x042808200C004110ULL, 0x4048080004820002ULL,
+    0x2001010000104000ULL, 0x000C024008081A00ULL, 0x0404040025108214ULL, 0x2000404001010802ULL,
+    0x0041041381202000ULL, 0x01008C1005601680ULL, 0x01D010900002040AULL, 0x4040020080080080ULL,
+    0x00050A0400820102ULL, 0x8018820080041000ULL, 0xC2014101200A0802ULL, 0x0108061042308052ULL,
+    0x8004020242201020ULL, 0x08A1008884122030ULL, 0x0202010028020480ULL, 0x5080008401001020ULL,
+    0x8820204410400400ULL, 0x0020020041100200ULL, 0x0844504200400201ULL, 0x1882480200800020ULL,
+    0xC002080404040400ULL, 0x0382004108292000ULL, 0xA005020442088020ULL, 0x2000042820880310ULL,
+    0x0803008821011400ULL, 0x4086080218420420ULL, 0x00B0200282860400ULL, 0x1088880100420028ULL,
+    0x1030820110010500ULL, 0x0080012608025800ULL, 0x0002810084008800ULL, 0x8009001800420200ULL,
+    0x000B000010021202ULL, 0x433080C0104C0120ULL, 0x0002906048112040ULL, 0x40106000A1160020ULL
+};
+
+U64 magicRngState = 0x9E3779B97F4A7C15ULL; // xorshift64*, fixed seed
+U64 magicRand() { magicRngState ^= magicRngState>>12; magicRngState ^= magicRngState<<25; magicRngState ^= magicRngState>>27; return magicRngState*0x2545F4914F6CDD1DULL; }
+
+void initSliderTable(Magic *magics, U64 *table, const U64 *known, const int dr[4], const int dc[4]) {
+    static U64 occ[4096], ref[4096]; static int epoch[4096];
+    int attempt = 0; U64 *ptr = table;
+    memset(epoch, 0, sizeof(epoch));
+    for (int sq=0; sq<64; sq++) {
+        Magic *m = &magics[sq]; int r = sq/8, c = sq%8;
+        // relevant occupancy: ray squares excluding the board edge the ray runs into
+        U64 edges = ((0xFFULL|0xFF00000000000000ULL) & ~(0xFFULL<<(8*r))) |
+                    ((0x0101010101010101ULL|0x8080808080808080ULL) & ~(0x0101010101010101ULL<<c));
+        m->mask = slidingAttackSlow(sq, 0, dr, dc) & ~edges;
+        m->shift = 64 - POPCNT(m->mask);
+        m->attacks = ptr;
+        int size = 0; U64 b = 0;
+        do { occ[size] = b; ref[size] = slidingAttackSlow(sq, b, dr, dc); size++; b = (b - m->mask) & m->mask; } while (b);
+#if defined(USE_PEXT)
+        m->magic = 0;
+        for (int i=0;i<size;i++) ptr[MAGIC_INDEX(m,occ[i])] = ref[i];
+#else
+        // verify the precomputed magic; fall back to a random search if it collides
+        m->magic = known[sq];
+        for (int i=0, tries=0; i<size; tries++) {
+            if (tries>0 || !m->magic) do { m->magic = magicRand() & magicRand() & magicRand(); } while (POPCNT((m->magic * m->mask) >> 56) < 6);
+            attempt++;
+            for (i=0; i<size; i++) {
+                U64 idx = MAGIC_INDEX(m, occ[i]);
+                if (epoch[idx] < attempt) { epoch[idx] = attempt; ptr[idx] = ref[i]; }
+                else if (ptr[idx] != ref[i]) break;
+            }
+        }
+#endif
+        ptr += size;
+    }
+}
+
+void initBitboards() {
+    for (int sq=0; sq<64; sq++) {
+        int r = sq/8, c = sq%8;
+        int kr[8]={-2,-2,-1,-1,1,1,2,2}, kc[8]={-1,1,-2,2,-2,2,-1,1};
+        knightAtt[sq] = kingAtt[sq] = pawnAtt[0][sq] = pawnAtt[1][sq] = 0;
+        for (int k=0;k<8;k++) if (validPos(r+kr[k],c+kc[k])) knightAtt[sq] |= BIT(SQ(r+kr[k],c+kc[k]));
+        for (int rr=r-1; rr<=r+1; rr++) for (int cc=c-1; cc<=c+1; cc++)
+            if (validPos(rr,cc) && (rr!=r || cc!=c)) kingAtt[sq] |= BIT(SQ(rr,cc));
+        for (int dc=-1; dc<=1; dc+=2) {
+            if (validPos(r-1,c+dc)) pawnAtt[0][sq] |= BIT(SQ(r-1,c+dc));
+            if (validPos(r+1,c+dc)) pawnAtt[1][sq] |= BIT(SQ(r+1,c+dc));
+        }
+    }
+    for (int a=0; a<64; a++) for (int b=0; b<64; b++) {
+        betweenBB[a][b] = lineBB[a][b] = 0;
+        int ar=a/8, ac=a%8, br=b/8, bc=b%8;
+        if (a==b || !(ar==br || ac==bc || abs(ar-br)==abs(ac-bc))) continue;
+        int dr = (br>ar)-(br<ar), dc = (bc>ac)-(bc<ac);
+        for (int rr=ar+dr, cc=ac+dc; rr!=br || cc!=bc; rr+=dr, cc+=dc) betweenBB[a][b] |= BIT(SQ(rr,cc));
+        lineBB[a][b] = BIT(a);
+        for (int rr=ar+dr, cc=ac+dc; validPos(rr,cc); rr+=dr, cc+=dc) lineBB[a][b] |= BIT(SQ(rr,cc));
+        for (int rr=ar-dr, cc=ac-dc; validPos(rr,cc); rr-=dr, cc-=dc) lineBB[a][b] |= BIT(SQ(rr,cc));
+    }
+    initSliderTable(rookMagic, rookTable, ROOK_MAGICS, ROOK_DR, ROOK_DC);
+    initSliderTable(bishopMagic, bishopTable, BISHOP_MAGICS, BISHOP_DR, BISHOP_DC);
+}
+
+/* ===== Zobrist hashing =====
+   Fixed seed, so keys are identical across runs and builds. The key covers the
+   pieces, the side to move, the castling rights and the ep file; the ep file
+   only counts when a pawn can actually capture there, so positions that merely
+   differ by an unusable ep square hash the same. */
+void initZobrist() {
+    U64 st = 0x2545F4914F6CDD1DULL; // own xorshift64* stream, independent of the magic search
+#define ZOB_NEXT() (st ^= st>>12, st ^= st<<25, st ^= st>>27, st*0x2545F4914F6CDD1DULL)
+    for (int p=0;p<12;p++) for (int sq=0;sq<64;sq++) zobPiece[p][sq] = ZOB_NEXT();
+    U64 right[4]; for (int i=0;i<4;i++) right[i] = ZOB_NEXT();
+    for (int m=0;m<16;m++) { zobCastle[m] = 0; for (int i=0;i<4;i++) if (m & (1<<i)) zobCastle[m] ^= right[i]; }
+    for (int f=0;f<8;f++) zobEp[f] = ZOB_NEXT();
+    zobSide = ZOB_NEXT();
+#undef ZOB_NEXT
+}
+
+// castling rights as a 4-bit mask: 1 = white O-O, 2 = white O-O-O, 4 = black O-O, 8 = black O-O-O
+int castleRights(const Position *pos) {
+    return (!pos->whiteKingMoved && !pos->whiteRookH_Moved) | (!pos->whiteKingMoved && !pos->whiteRookA_Moved)<<1 |
+           (!pos->blackKingMoved && !pos->blackRookH_Moved)<<2 | (!pos->blackKingMoved && !pos->blackRookA_Moved)<<3;
+}
+
+// an enemy pawn stands ready to capture en passant (the same rule as Polyglot keys)
+int epCapturable(const Position *pos) {
+    if (pos->epR<0) return 0;
+    int sq = SQ(pos->epR,pos->epC);
+    return ((pos->epR==5) ? pawnAtt[0][sq] & pos->pieceBB[BP] : pawnAtt[1][sq] & pos->pieceBB[WP]) != 0;
+}
+
+// ep contribution to the key: only when the capture is actually possible
+U64 epKey(const Position *pos) { return epCapturable(pos) ? zobEp[pos->epC] : 0; }
+
+// earlier occurrences of keys[n-1] (the current position) among keys[0..n-2]. Only
+// the last window plies (halfmoveClock) can repeat, and only every second one has
+// the same side to move, so this is a bounded backward scan; stops at stopAt hits
+int repetitionCount(const U64 *keys, int n, int window, int stopAt) {
+    int cnt = 0, stop = n-1-window; U64 k = keys[n-1];
+    if (stop<0) stop = 0;
+    for (int i=n-3; i>=stop; i-=2) if (keys[i]==k && ++cnt>=stopAt) break;
+    return cnt;
+}
+
+// full recomputation; used after bulk setup and to cross-check the incremental key
+U64 computeKey(const Position *pos, char side) {
+    U64 k = zobCastle[castleRights(pos)] ^ epKey(pos) ^ (side=='b' ? zobSide : 0);
+    for (int p=0;p<12;p++) for (U64 b=pos->pieceBB[p]; b; b&=b-1) k ^= zobPiece[p][LSB(b)];
+    return k;
+}
+
+/* ===== Transposition table =====
+   Buckets of four 16-byte entries fill one 64-byte cache line. Entries are
+   written without locks: each stores key^data next to data, so a reader from
+   another thread that sees a torn (half-written) entry simply gets a miss. */
+typedef struct { U64 check, data; } TTEntry;  // check = key ^ data
+typedef struct { TTEntry e[4]; } TTBucket;
+
+enum { TT_NONE, TT_UPPER, TT_LOWER, TT_EXACT };
+#define TT_DEFAULT_MB 16
+
+// data layout: move 0-15 | score 16-31 (signed) | depth 32-39 | bound 40-41 | generation 48-55
+#define TT_PACK(mv,sc,dp,bd,gen) ((U64)(unsigned short)(mv) | (U64)(unsigned short)(short)(sc)<<16 | \
+                                  (U64)(unsigned char)(dp)<<32 | (U64)(bd)<<40 | (U64)(unsigned char)(gen)<<48)
+#define TT_MOVE(d)  ((PackedMove)(d))
+#define TT_SCORE(d) ((int)(short)((d)>>16))
+#define TT_DEPTH(d) ((int)(unsigned char)((d)>>32))
+#define TT_BOUND(d) ((int)(((d)>>40)&3))
+#define TT_GEN(d)   ((unsigned char)((d)>>48))
+
+typedef struct { int depth, bound, score; PackedMove move; } TTHit;
+
+typedef struct {
+    TTBucket *table; void *raw;
+    U64 mask;                // bucket count - 1 (power of two)
+    unsigned char gen;       // bumped once per search, ages old entries
+} TransTable;
+
+TransTable mainTT;           // shared by the interactive game and UCI mode
+long long ttSizeMb = TT_DEFAULT_MB;
+
+void ttClear(TransTable *tt) { if (tt->table) memset(tt->table, 0, (size_t)(tt->mask+1)*sizeof(TTBucket)); tt->gen = 0; }
+
+// (re)allocate the table with the largest power-of-two bucket count that fits in mb megabytes
+int ttResize(TransTable *tt, size_t mb) {
+    U64 buckets = 1; if (mb<1) mb = 1;
+    while (buckets*2*sizeof(TTBucket) <= (U64)mb*1024*1024) buckets *= 2;
+    void *raw = malloc((size_t)buckets*sizeof(TTBucket) + 63);
+    if (!raw) return 0;
+    free(tt->raw); tt->raw = raw;
+    tt->table = (TTBucket*)(((size_t)raw + 63) & ~(size_t)63);
+    tt->mask = buckets-1; ttClear(tt);
+    return 1;
+}
+
+void ttFree(TransTable *tt) { free(tt->raw); tt->raw = NULL; tt->table = NULL; tt->mask = 0; }
+
+void ttNewSearch(TransTable *tt) { tt->gen++; }
+
+int ttProbe(const TransTable *tt, U64 key, TTHit *out) {
+    TTBucket *b = &tt->table[key & tt->mask];
+    STAT_ADD(ST_TT_PROBES, 1);
+    for (int i=0;i<4;i++) {
+        U64 data = b->e[i].data, check = b->e[i].check;
+        if ((check ^ data) == key && TT_BOUND(data)!=TT_NONE) {
+            out->depth = TT_DEPTH(data); out->bound = TT_BOUND(data); out->score = TT_SCORE(data); out->move = TT_MOVE(data);
+            STAT_ADD(ST_TT_HITS, 1);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// replace the entry for the same key (keeping its move if we have none), else the
+// shallowest / oldest entry in the bucket
+void ttStore(TransTable *tt, U64 key, int depth, int bound, int score, PackedMove move) {
+    TTBucket *b = &tt->table[key & tt->mask]; TTEntry *victim = &b->e[0]; int worst = 1<<30;
+    depth = depth<0 ? 0 : depth>255 ? 255 : depth;
+    for (int i=0;i<4;i++) {
+        TTEntry *e = &b->e[i]; U64 data = e->data;
+        if ((e->check ^ data) == key) {
+            if (!move) move = TT_MOVE(data);
+            // keep a deeper bound from this search unless the new result is exact
+            if (bound!=TT_EXACT && TT_GEN(data)==tt->gen && depth+3 < TT_DEPTH(data)) return;
+            victim = e; break;
+        }
+        int value = TT_DEPTH(data) - 8*(unsigned char)(tt->gen - TT_GEN(data));
+        if (value < worst) { worst = value; victim = e; }
+    }
+    U64 data = TT_PACK(move, score, depth, bound, tt->gen);
+    victim->data = data; victim->check = key ^ data;
+}
+
+void initBoard(Game *g) {
+    Position *pos = &g->pos;
     const char *init[8] = {
         "rnbqkbnr",
         "pppppppp",
@@ -62,116 +645,255 @@ void initBoard() {
         "PPPPPPPP",
         "RNBQKBNR"
     };
-    for (int r=0;r<8;r++) for (int c=0;c<8;c++) board[r][c]=init[r][c];
-    lastFromR=lastFromC=lastToR=lastToC=-1;
-    halfmoveClock = 0; fullmoveNumber = 1; historyCount = 0; gameOver = 0;
-    whiteKingMoved = blackKingMoved = 0;
-    whiteRookA_Moved = whiteRookH_Moved = 0;
-    blackRookA_Moved = blackRookH_Moved = 0;
-    epR = epC = -1;
+    for (int r=0;r<8;r++) for (int c=0;c<8;c++) pos->board[r][c]=init[r][c];
+    syncBitboards(pos);
+    g->lastFromR=g->lastFromC=g->lastToR=g->lastToC=-1;
+    pos->halfmoveClock = 0; pos->fullmoveNumber = 1; g->historyCount = 0; g->gameOver = 0;
+    pos->whiteKingMoved = pos->blackKingMoved = 0;
+    pos->whiteRookA_Moved = pos->whiteRookH_Moved = 0;
+    pos->blackRookA_Moved = pos->blackRookH_Moved = 0;
+    pos->epR = pos->epC = -1;
+    pos->key = computeKey(pos, 'w');
+    g->keys[0] = pos->key; g->startPos = *pos; g->startSide = 'w';
+    g->shownValid = 0;
+}
+
+// side to move after the recorded plies
+char sideToMove(const Game *g) {
+    return (g->historyCount%2==0) == (g->startSide=='w') ? 'w' : 'b';
 }
 
+/* ===== Board rendering =====
+   A frame is built in one buffer and sent with a single write, instead of a
+   printf per square. --quiet skips rendering entirely (headless sessions over
+   pipes); --diff draws the full board once at the top of the screen and from
+   then on sends only the squares that changed, addressed with cursor moves.
+   Everything below the board (prompts, search info) scrolls inside a scroll
+   region, so the board rows never move; later frames patch the board with the
+   cursor saved and then continue the text where it left off, so messages
+   printed between frames stay on screen. */
 const char *RESET = "\x1b[0m";
 const char *REV = "\x1b[7m";
+enum { RENDER_FULL, RENDER_DIFF, RENDER_QUIET };
+int renderMode = RENDER_FULL;
+int diffScreenReady;         // diff mode: the screen was cleared and the scroll region set
+#define FRAME_MAX 4096
+#define FRAME_ROW0 3   // screen row of rank 8 in diff mode (1-based)
+#define FRAME_TEXT_ROW (FRAME_ROW0+9) // first row of the scrolling text below the board
 
-void printBoard() {
-    printf("\n    a b c d e f g h\n");
-    printf("   -----------------\n");
+// append text to a frame, truncating at FRAME_MAX
+static inline void frameStr(char *f, int *n, const char *str) {
+    while (*str && *n<FRAME_MAX-1) f[(*n)++] = *str++;
+    f[*n] = '\0';
+}
+
+void frameAdd(char *f, int *n, const char *fmt, ...) {
+    va_list ap; va_start(ap, fmt);
+    int k = vsnprintf(f+*n, FRAME_MAX-*n, fmt, ap);
+    va_end(ap);
+    if (k>0) *n = *n+k < FRAME_MAX ? *n+k : FRAME_MAX-1;
+}
+
+// the whole frame goes out in one write; earlier stdio output is flushed first to keep the order
+void emitFrame(const char *f, int n) {
+    fflush(stdout);
+#ifdef _WIN32
+    fwrite(f, 1, n, stdout); fflush(stdout);
+#else
+    while (n>0) { ssize_t w = write(STDOUT_FILENO, f, n); if (w<=0) break; f += w; n -= (int)w; }
+#endif
+}
+
+U64 highlightMask(const Game *g) {
+    U64 m = 0;
+    if (g->lastFromR>=0) m |= BIT(SQ(g->lastFromR,g->lastFromC));
+    if (g->lastToR>=0) m |= BIT(SQ(g->lastToR,g->lastToC));
+    return m;
+}
+
+void frameSquare(char *f, int *n, char piece, int hl) {
+    char cell[2] = { piece, '\0' };
+    if (hl) frameStr(f, n, REV);
+    frameStr(f, n, cell);
+    if (hl) frameStr(f, n, RESET);
+}
+
+void frameStatus(const Game *g, char *f, int *n) {
+    frameAdd(f, n, "Halfmove clock: %d | Fullmove: %d\n", g->pos.halfmoveClock, g->pos.fullmoveNumber);
+    if (g->historyCount>0) {
+        int start = g->historyCount>8 ? g->historyCount-8 : 0;
+        frameAdd(f, n, "History (last): ");
+        for (int i=start;i<g->historyCount;i++) { char mv[16]; formatMove(g->moves[i], mv, sizeof(mv)); frameStr(f, n, mv); frameStr(f, n, " "); }
+        frameStr(f, n, "\n");
+    }
+}
+
+void frameBoard(const Game *g, char *f, int *n, U64 hl) {
+    frameStr(f, n, "    a b c d e f g h\n   -----------------\n");
     for (int r=0;r<8;r++) {
-        printf("%d | ", 8-r);
-        for (int c=0;c<8;c++) {
-            int hl = (r==lastFromR && c==lastFromC) || (r==lastToR && c==lastToC);
-            if (hl) printf("%s", REV);
-            putchar(board[r][c]);
-            if (hl) printf("%s", RESET);
-            printf(" ");
-        }
-        printf("|\n");
-    }
-    printf("   -----------------\n");
-    printf("Halfmove clock: %d | Fullmove: %d\n", halfmoveClock, fullmoveNumber);
-    if (historyCount>0) {
-        int start = historyCount>8 ? historyCount-8 : 0;
-        printf("History (last): ");
-        for (int i=start;i<historyCount;i++) printf("%s ", history[i]);
-        printf("\n");
+        char rank[5] = { '8'-r, ' ', '|', ' ', '\0' };
+        frameStr(f, n, rank);
+        for (int c=0;c<8;c++) { frameSquare(f, n, g->pos.board[r][c], (hl>>SQ(r,c))&1); frameStr(f, n, " "); }
+        frameStr(f, n, "|\n");
     }
+    frameStr(f, n, "   -----------------\n");
 }
 
-/* ===== Attack detection ===== */
-int isSquareAttacked(int r,int c,char bySide) {
-    if (!validPos(r,c)) return 0;
-    // pawns
-    if (bySide=='w') {
-        int rr=r+1;
-        if (validPos(rr,c-1) && board[rr][c-1]=='P') return 1;
-        if (validPos(rr,c+1) && board[rr][c+1]=='P') return 1;
+void printBoard(Game *g) {
+    char f[FRAME_MAX]; int n = 0; U64 hl = highlightMask(g);
+    if (renderMode==RENDER_QUIET) return;
+    if (renderMode==RENDER_FULL) { frameStr(f, &n, "\n"); frameBoard(g, f, &n, hl); frameStatus(g, f, &n); emitFrame(f, n); return; }
+    if (!diffScreenReady) {
+        frameStr(f, &n, "\x1b[r\x1b[H\x1b[J"); frameBoard(g, f, &n, hl);
+        frameAdd(f, &n, "\x1b[%dr\x1b[%d;1H", FRAME_TEXT_ROW, FRAME_TEXT_ROW); // setting the region homes the cursor
+        diffScreenReady = 1;
     } else {
-        int rr=r-1;
-        if (validPos(rr,c-1) && board[rr][c-1]=='p') return 1;
-        if (validPos(rr,c+1) && board[rr][c+1]=='p') return 1;
-    }
-    // knights
-    int kr[8]={-2,-2,-1,-1,1,1,2,2}, kc[8]={-1,1,-2,2,-2,2,-1,1};
-    for (int k=0;k<8;k++) {
-        int rr=r+kr[k], cc=c+kc[k]; if (!validPos(rr,cc)) continue;
-        char ch = board[rr][cc];
-        if (bySide=='w' && ch=='N') return 1;
-        if (bySide=='b' && ch=='n') return 1;
-    }
-    // orthogonal sliding
-    int orr[4]={-1,1,0,0}, orc[4]={0,0,-1,1};
-    for (int d=0;d<4;d++){
-        int rr=r+orr[d], cc=c+orc[d];
-        while (validPos(rr,cc)){
-            char ch=board[rr][cc]; if (ch!='.'){
-                if (bySide=='w' && (ch=='R' || ch=='Q')) return 1;
-                if (bySide=='b' && (ch=='r' || ch=='q')) return 1;
-                break;
-            }
-            rr+=orr[d]; cc+=orc[d];
+        U64 changed = hl ^ g->shownHl;
+        frameStr(f, &n, "\x1b" "7"); // save the text cursor
+        for (int sq=0;sq<64;sq++) if (!g->shownValid || (changed>>sq)&1 || g->pos.board[sq/8][sq%8]!=g->shown[sq/8][sq%8]) {
+            frameAdd(f, &n, "\x1b[%d;%dH", FRAME_ROW0+sq/8, 5+2*(sq%8));
+            frameSquare(f, &n, g->pos.board[sq/8][sq%8], (hl>>sq)&1);
         }
+        frameStr(f, &n, "\x1b" "8"); // status lines follow the text printed since the last frame
     }
-    // diagonal sliding
-    int dgr[4]={-1,-1,1,1}, dgc[4]={-1,1,-1,1};
-    for (int d=0;d<4;d++){
-        int rr=r+dgr[d], cc=c+dgc[d];
-        while (validPos(rr,cc)){
-            char ch=board[rr][cc]; if (ch!='.'){
-                if (bySide=='w' && (ch=='B' || ch=='Q')) return 1;
-                if (bySide=='b' && (ch=='b' || ch=='q')) return 1;
-                break;
-            }
-            rr+=dgr[d]; cc+=dgc[d];
-        }
+    frameStatus(g, f, &n);
+    memcpy(g->shown, g->pos.board, sizeof(g->shown)); g->shownHl = hl; g->shownValid = 1;
+    emitFrame(f, n);
+}
+
+// give the whole screen back to the terminal, keeping the cursor where it is
+void resetScrollRegion(void) { const char *s = "\x1b" "7\x1b[r\x1b" "8"; emitFrame(s, (int)strlen(s)); }
+
+/* ===== Attack detection ===== */
+// every piece of either color attacking sq, given occupancy occ
+U64 attackersTo(const Position *pos, int sq, U64 occ) {
+    return (pawnAtt[1][sq] & pos->pieceBB[WP]) | (pawnAtt[0][sq] & pos->pieceBB[BP])
+         | (knightAtt[sq] & (pos->pieceBB[WN]|pos->pieceBB[BN]))
+         | (kingAtt[sq] & (pos->pieceBB[WK]|pos->pieceBB[BK]))
+         | (bishopAttacks(sq,occ) & (pos->pieceBB[WB]|pos->pieceBB[BB]|pos->pieceBB[WQ]|pos->pieceBB[BQ]))
+         | (rookAttacks(sq,occ) & (pos->pieceBB[WR]|pos->pieceBB[BR]|pos->pieceBB[WQ]|pos->pieceBB[BQ]));
+}
+
+int isSquareAttacked(const Position *pos, int r,int c,char bySide) {
+    STAT_ADD(ST_ATTACK_TESTS, 1);
+    if (!validPos(r,c)) return 0;
+    int sq = SQ(r,c), o = (bySide=='w') ? 0 : 6; U64 occ = pos->occBB[2];
+    // a pawn of bySide attacks sq iff it stands where an opposite pawn on sq would attack
+    if (pawnAtt[bySide=='w' ? 1 : 0][sq] & pos->pieceBB[WP+o]) return 1;
+    if (knightAtt[sq] & pos->pieceBB[WN+o]) return 1;
+    if (kingAtt[sq] & pos->pieceBB[WK+o]) return 1;
+    if (bishopAttacks(sq,occ) & (pos->pieceBB[WB+o]|pos->pieceBB[WQ+o])) return 1;
+    if (rookAttacks(sq,occ) & (pos->pieceBB[WR+o]|pos->pieceBB[WQ+o])) return 1;
+    return 0;
+}
+
+/* ===== FEN import / export =====
+   Castling rights map onto the *_Moved flags (a right is kept only when king and
+   rook still stand on their home squares), the ep square onto epR/epC. */
+#define FEN_MAX 100
+
+// load a FEN position (board, side, castling, ep, clocks); returns 0 on malformed or impossible input.
+// Clocks may be omitted (EPD style) and default to 0 and 1
+int loadFen(Position *pos, const char *fen, char *sideOut) {
+    int r=0, c=0; const char *s = fen;
+    while (*s==' ') s++;
+    for (int i=0;i<8;i++) for (int j=0;j<8;j++) pos->board[i][j]='.';
+    while (*s && *s!=' ') {
+        if (*s=='/') { if (c!=8 || ++r>7) return 0; c=0; }
+        else if (*s>='1' && *s<='8') { c += *s-'0'; if (c>8) return 0; }
+        else if (strchr("PNBRQKpnbrqk",*s) && c<8) pos->board[r][c++] = *s;
+        else return 0;
+        s++;
     }
-    // king
-    for (int rr=r-1; rr<=r+1; rr++) for (int cc=c-1; cc<=c+1; cc++){
-        if (!validPos(rr,cc) || (rr==r&&cc==c)) continue;
-        char ch = board[rr][cc]; if (bySide=='w' && ch=='K') return 1; if (bySide=='b' && ch=='k') return 1;
+    if (r!=7 || c!=8) return 0;
+    syncBitboards(pos);
+    // exactly one king each, no pawns on the back ranks
+    if (pos->pieceCount[WK]!=1 || pos->pieceCount[BK]!=1) return 0;
+    if ((pos->pieceBB[WP]|pos->pieceBB[BP]) & 0xFF000000000000FFULL) return 0;
+    while (*s==' ') s++;
+    if (*s!='w' && *s!='b') return 0;
+    char side = *s++;
+    while (*s==' ') s++;
+    pos->whiteKingMoved = pos->blackKingMoved = 1;
+    pos->whiteRookA_Moved = pos->whiteRookH_Moved = pos->blackRookA_Moved = pos->blackRookH_Moved = 1;
+    if (*s=='-') s++;
+    else while (*s && *s!=' ') {
+        if (*s=='K' && pos->board[7][4]=='K' && pos->board[7][7]=='R') { pos->whiteKingMoved=0; pos->whiteRookH_Moved=0; }
+        else if (*s=='Q' && pos->board[7][4]=='K' && pos->board[7][0]=='R') { pos->whiteKingMoved=0; pos->whiteRookA_Moved=0; }
+        else if (*s=='k' && pos->board[0][4]=='k' && pos->board[0][7]=='r') { pos->blackKingMoved=0; pos->blackRookH_Moved=0; }
+        else if (*s=='q' && pos->board[0][4]=='k' && pos->board[0][0]=='r') { pos->blackKingMoved=0; pos->blackRookA_Moved=0; }
+        else if (!strchr("KQkq",*s)) return 0;
+        s++;
     }
-    return 0;
+    while (*s==' ') s++;
+    pos->epR = pos->epC = -1;
+    if (*s>='a' && *s<='h' && s[1]>='1' && s[1]<='8') {
+        // only a square just passed by a double pawn push is meaningful; others are dropped
+        int er = 8-(s[1]-'0'), ec = s[0]-'a';
+        if (er==(side=='w' ? 2 : 5) && pos->board[side=='w' ? 3 : 4][ec]==(side=='w' ? 'p' : 'P') && pos->board[er][ec]=='.') { pos->epR = er; pos->epC = ec; }
+        s+=2;
+    }
+    else if (*s=='-') s++;
+    else if (*s) return 0;
+    pos->halfmoveClock = 0; pos->fullmoveNumber = 1;
+    sscanf(s, "%d %d", &pos->halfmoveClock, &pos->fullmoveNumber);
+    if (pos->halfmoveClock<0) pos->halfmoveClock = 0;
+    if (pos->fullmoveNumber<1) pos->fullmoveNumber = 1;
+    // the side that just moved cannot be left in check
+    int ek = pos->kingSq[side=='w' ? 1 : 0];
+    if (isSquareAttacked(pos, ek/8, ek%8, side)) return 0;
+    pos->key = computeKey(pos, side);
+    if (sideOut) *sideOut = side;
+    return 1;
 }
 
-/* ===== Helpers: path clear for sliding pieces ===== */
-int pathClear(int fr,int fc,int tr,int tc) {
-    int dr = (tr>fr) ? 1 : (tr<fr) ? -1 : 0;
-    int dc = (tc>fc) ? 1 : (tc<fc) ? -1 : 0;
-    int rr = fr+dr, cc = fc+dc;
-    while (rr!=tr || cc!=tc) {
-        if (!validPos(rr,cc)) return 0;
-        if (board[rr][cc] != '.') return 0;
-        rr += dr; cc += dc;
+// write pos as FEN into out (at least FEN_MAX bytes)
+void toFen(const Position *pos, char side, char *out) {
+    char *o = out;
+    for (int r=0;r<8;r++) {
+        int empty = 0;
+        for (int c=0;c<8;c++) {
+            char p = pos->board[r][c];
+            if (p=='.') { empty++; continue; }
+            if (empty) { *o++ = '0'+empty; empty = 0; }
+            *o++ = p;
+        }
+        if (empty) *o++ = '0'+empty;
+        if (r<7) *o++ = '/';
     }
+    *o++ = ' '; *o++ = side; *o++ = ' ';
+    int cr = castleRights(pos);
+    if (!cr) *o++ = '-';
+    for (int i=0;i<4;i++) if (cr>>i&1) *o++ = "KQkq"[i];
+    *o++ = ' ';
+    if (pos->epR>=0) { *o++ = 'a'+pos->epC; *o++ = '0'+(8-pos->epR); } else *o++ = '-';
+    sprintf(o, " %d %d", pos->halfmoveClock, pos->fullmoveNumber);
+}
+
+// start a fresh game record from a FEN; the game is left untouched on malformed input
+int initGameFromFen(Game *g, const char *fen) {
+    Position pos; char side;
+    if (!loadFen(&pos, fen, &side)) return 0;
+    g->pos = g->startPos = pos; g->startSide = side;
+    g->lastFromR=g->lastFromC=g->lastToR=g->lastToC=-1;
+    g->historyCount = 0; g->gameOver = 0; g->keys[0] = pos.key;
     return 1;
 }
 
+/* ===== Helpers: path clear for sliding pieces ===== */
+int pathClear(const Position *pos, int fr,int fc,int tr,int tc) {
+    if (!validPos(fr,fc) || !validPos(tr,tc)) return 0;
+    int dr = abs(tr-fr), dc = abs(tc-fc);
+    if (!(dr==0 || dc==0 || dr==dc)) return 0;
+    return (betweenBB[SQ(fr,fc)][SQ(tr,tc)] & pos->occBB[2]) == 0;
+}
+
 /* ===== Move legality (pattern only) ===== */
-int isLegalPatternMove(int fr,int fc,int tr,int tc) {
+int isLegalPatternMove(const Position *pos, int fr,int fc,int tr,int tc) {
     if (!validPos(fr,fc) || !validPos(tr,tc)) return 0;
     if (fr==tr && fc==tc) return 0;
-    char p = board[fr][fc]; if (p=='.') return 0;
-    char target = board[tr][tc];
+    char p = pos->board[fr][fc]; if (p=='.') return 0;
+    char target = pos->board[tr][tc];
     // cannot capture own piece
     if (target != '.') {
         if ((isupper(p) && isupper(target)) || (islower(p) && islower(target))) return 0;
@@ -183,7 +905,7 @@ int isLegalPatternMove(int fr,int fc,int tr,int tc) {
         if (tc==fc && tr==fr+dir && target=='.') return 1;
         // double from starting rank
         if (tc==fc && tr==fr+2*dir && target=='.') {
-            int midr = fr+dir; if (board[midr][fc]=='.') {
+            int midr = fr+dir; if (pos->board[midr][fc]=='.') {
                 if ((p=='P' && fr==6) || (p=='p' && fr==1)) return 1;
             }
         }
@@ -197,16 +919,16 @@ int isLegalPatternMove(int fr,int fc,int tr,int tc) {
         return (dr==2 && dc==1) || (dr==1 && dc==2);
     }
     if (p=='B' || p=='b') {
-        if (abs(tr-fr) == abs(tc-fc)) return pathClear(fr,fc,tr,tc);
+        if (abs(tr-fr) == abs(tc-fc)) return pathClear(pos, fr,fc,tr,tc);
         return 0;
     }
     if (p=='R' || p=='r') {
-        if (tr==fr || tc==fc) return pathClear(fr,fc,tr,tc);
+        if (tr==fr || tc==fc) return pathClear(pos, fr,fc,tr,tc);
         return 0;
     }
     if (p=='Q' || p=='q') {
-        if (tr==fr || tc==fc) return pathClear(fr,fc,tr,tc);
-        if (abs(tr-fr) == abs(tc-fc)) return pathClear(fr,fc,tr,tc);
+        if (tr==fr || tc==fc) return pathClear(pos, fr,fc,tr,tc);
+        if (abs(tr-fr) == abs(tc-fc)) return pathClear(pos, fr,fc,tr,tc);
         return 0;
     }
     if (p=='K' || p=='k') {
@@ -218,281 +940,1749 @@ int isLegalPatternMove(int fr,int fc,int tr,int tc) {
 }
 
 /* ===== Would move leave own king in check? (simulate) ===== */
-void applyMoveTemp(int fr,int fc,int tr,int tc, char *savedFrom, char *savedTo) {
-    *savedFrom = board[fr][fc]; *savedTo = board[tr][tc];
-    board[tr][tc] = board[fr][fc]; board[fr][fc] = '.';
+void applyMoveTemp(Position *pos, int fr,int fc,int tr,int tc, char *savedFrom, char *savedTo) {
+    *savedFrom = pos->board[fr][fc]; *savedTo = pos->board[tr][tc];
+    setSquare(pos,tr,tc,pos->board[fr][fc]); setSquare(pos,fr,fc,'.');
 }
-void unapplyMoveTemp(int fr,int fc,int tr,int tc, char savedFrom, char savedTo) {
-    board[fr][fc] = savedFrom; board[tr][tc] = savedTo;
+void unapplyMoveTemp(Position *pos, int fr,int fc,int tr,int tc, char savedFrom, char savedTo) {
+    setSquare(pos,fr,fc,savedFrom); setSquare(pos,tr,tc,savedTo);
 }
 
-int wouldLeaveKingInCheck(int fr,int fc,int tr,int tc) {
-    char savedFrom, savedTo; applyMoveTemp(fr,fc,tr,tc,&savedFrom,&savedTo);
-    // find king of the mover
-    char mover = savedFrom; char king = (isupper(mover)?'K':'k');
-    int kr=-1,kc=-1;
-    for (int r=0;r<8;r++) for (int c=0;c<8;c++) if (board[r][c]==king) { kr=r; kc=c; }
+int wouldLeaveKingInCheck(Position *pos, int fr,int fc,int tr,int tc) {
+    char savedFrom, savedTo; applyMoveTemp(pos, fr,fc,tr,tc,&savedFrom,&savedTo);
+    // king of the mover
+    char mover = savedFrom; int ksq = pos->kingSq[isupper(mover) ? 0 : 1];
     int attacked = 1; // default assume attacked if king missing
-    if (kr!=-1) attacked = isSquareAttacked(kr,kc, isupper(mover)?'b':'w');
-    unapplyMoveTemp(fr,fc,tr,tc,savedFrom,savedTo);
+    if (ksq!=-1) attacked = isSquareAttacked(pos, ksq/8,ksq%8, isupper(mover)?'b':'w');
+    unapplyMoveTemp(pos, fr,fc,tr,tc,savedFrom,savedTo);
     return attacked;
 }
 
-/* ===== Generate legal moves (no check leaving king) ===== */
-typedef struct {int fr,fc,tr,tc; char promo;} GenMove;
-GenMove genList[MAX_MOVES]; int genCount=0;
+/* ===== Generate legal moves (no check leaving king) =====
+   Enumerates only reachable squares per piece. Check and pin masks are computed
+   once per position, so ordinary moves are legal by construction; only king
+   steps and en-passant are verified against the resulting occupancy. */
+// move list owned by the caller (one per ply / per thread)
+typedef struct { PackedMove moves[MAX_MOVES]; int count; } MoveList;
+
+void addMove(MoveList *list, PackedMove m) {
+    if (list->count < MAX_MOVES) list->moves[list->count++] = m;
+}
+
+// index of the generated move matching from/to (the queen promotion if several), or -1
+int findMove(const MoveList *list, int fr,int fc,int tr,int tc) {
+    int from = SQ(fr,fc), to = SQ(tr,tc);
+    for (int i=0;i<list->count;i++) if (PM_FROM(list->moves[i])==from && PM_TO(list->moves[i])==to) return i;
+    return -1;
+}
+
+// add one move per target bit; pawn moves reaching the last rank expand to Q/R/B/N
+void addTargets(MoveList *list, int from, U64 targets, int promoRank) {
+    while (targets) {
+        int to = LSB(targets); targets &= targets-1;
+        if (to/8 == promoRank) { for (int k=3;k>=0;k--) addMove(list, PACK_MOVE(from,to,MT_PROMO,k)); }
+        else addMove(list, PACK_MOVE(from,to,MT_NORMAL,0));
+    }
+}
+
+// would side us (0 = white) have its king on ksq attacked, given occupancy occ and
+// with the pieces in 'removed' taken off the board?
+int kingAttackedWith(const Position *pos, int ksq, int us, U64 occ, U64 removed) {
+    return (attackersTo(pos, ksq, occ) & pos->occBB[!us] & ~removed) != 0;
+}
+
+// may side us (0 = white) castle short (kingSide) or long? Rights, rook, empty path and
+// unattacked crossing squares; the caller has already made sure the king is not in check
+int canCastle(const Position *pos, int us, int kingSide) {
+    int hr = us ? 0 : 7; char enemy = us ? 'w' : 'b', rook = us ? 'r' : 'R'; U64 occ = pos->occBB[2];
+    if (pos->kingSq[us]!=SQ(hr,4) || (us ? pos->blackKingMoved : pos->whiteKingMoved)) return 0;
+    if (kingSide) return !(us ? pos->blackRookH_Moved : pos->whiteRookH_Moved) && pos->board[hr][7]==rook
+        && !(occ & (BIT(SQ(hr,5))|BIT(SQ(hr,6)))) && !isSquareAttacked(pos, hr,5,enemy) && !isSquareAttacked(pos, hr,6,enemy);
+    return !(us ? pos->blackRookA_Moved : pos->whiteRookA_Moved) && pos->board[hr][0]==rook
+        && !(occ & (BIT(SQ(hr,1))|BIT(SQ(hr,2))|BIT(SQ(hr,3)))) && !isSquareAttacked(pos, hr,3,enemy) && !isSquareAttacked(pos, hr,2,enemy);
+}
+
+// what generateMoves produces: captures (en-passant and every promotion included),
+// quiet moves (castling included), or both; GEN_FIRST stops at the first legal move
+#define GEN_CAPTURES 1
+#define GEN_QUIETS   2
+#define GEN_ALL      3
+#define GEN_FIRST    4
+
+static void genMoves(const Position *pos, char side, MoveList *list, int flags) {
+    list->count = 0; int firstOnly = flags & GEN_FIRST;
+    int us = (side=='w') ? 0 : 1, o = us ? 6 : 0, e = us ? 0 : 6;
+    int ksq = pos->kingSq[us];
+    if (ksq<0) return; // no king: nothing is legal
+    U64 own = pos->occBB[us], opp = pos->occBB[!us], occ = pos->occBB[2];
+    U64 checkers = attackersTo(pos, ksq, occ) & opp;
+    U64 wanted = ((flags & GEN_CAPTURES) ? opp : 0) | ((flags & GEN_QUIETS) ? ~occ : 0);
+
+    // king steps: verified with the king lifted off so sliders see through it
+    U64 kt = kingAtt[ksq] & wanted;
+    while (kt) {
+        int to = LSB(kt); kt &= kt-1;
+        if (!kingAttackedWith(pos, to, us, (occ ^ BIT(ksq)) | BIT(to), BIT(to))) addMove(list, PACK_MOVE(ksq,to,MT_NORMAL,0));
+    }
+    if (POPCNT(checkers) > 1 || (firstOnly && list->count)) return; // double check: only the king may move
+
+    // targets that capture the checker or block its line
+    U64 checkMask = checkers ? (checkers | betweenBB[ksq][LSB(checkers)]) : ~0ULL;
+
+    // own pieces alone between our king and an enemy slider on the same line
+    U64 pinned = 0;
+    U64 snipers = (rookAttacks(ksq,0) & (pos->pieceBB[WR+e]|pos->pieceBB[WQ+e])) | (bishopAttacks(ksq,0) & (pos->pieceBB[WB+e]|pos->pieceBB[WQ+e]));
+    while (snipers) {
+        int s = LSB(snipers); snipers &= snipers-1;
+        U64 b = betweenBB[ksq][s] & occ;
+        if (b && !(b & (b-1)) && (b & own)) pinned |= b;
+    }
+
+    // pawns
+    int fwd = us ? 8 : -8, startRank = us ? 1 : 6, promoRank = us ? 7 : 0;
+    U64 promoBB = 0xFFULL << (promoRank*8), pawns = pos->pieceBB[WP+o];
+    while (pawns) {
+        int from = LSB(pawns); pawns &= pawns-1;
+        U64 allowed = checkMask & ((pinned & BIT(from)) ? lineBB[ksq][from] : ~0ULL);
+        U64 t = 0; int one = from + fwd;
+        if (!(occ & BIT(one))) {
+            t |= BIT(one);
+            if (from/8 == startRank && !(occ & BIT(one+fwd))) t |= BIT(one+fwd);
+        }
+        t = ((flags & GEN_CAPTURES) ? (pawnAtt[us][from] & opp) | (t & promoBB) : 0) | ((flags & GEN_QUIETS) ? t & ~promoBB : 0);
+        addTargets(list, from, t & allowed, promoRank);
+        // en-passant: capture removes a pawn off the moving line, so verify directly
+        if (pos->epR!=-1 && (flags & GEN_CAPTURES)) {
+            int ep = SQ(pos->epR,pos->epC), cap = ep - fwd;
+            if ((pawnAtt[us][from] & BIT(ep)) && (pos->pieceBB[WP+e] & BIT(cap)) && !(occ & BIT(ep))) {
+                U64 occ2 = (occ ^ BIT(from) ^ BIT(cap)) | BIT(ep);
+                if (!kingAttackedWith(pos, ksq, us, occ2, BIT(cap))) addMove(list, PACK_MOVE(from,ep,MT_EP,0));
+            }
+        }
+        if (firstOnly && list->count) return;
+    }
+
+    // pieces: pinned knights never move, pinned sliders stay on the pin line
+    U64 knights = pos->pieceBB[WN+o] & ~pinned;
+    while (knights) { int from = LSB(knights); knights &= knights-1; addTargets(list, from, knightAtt[from] & wanted & checkMask, -1); }
+    if (firstOnly && list->count) return;
+    U64 diag = pos->pieceBB[WB+o] | pos->pieceBB[WQ+o];
+    while (diag) {
+        int from = LSB(diag); diag &= diag-1;
+        U64 t = bishopAttacks(from, occ) & wanted & checkMask;
+        if (pinned & BIT(from)) t &= lineBB[ksq][from];
+        addTargets(list, from, t, -1);
+        if (firstOnly && list->count) return;
+    }
+    U64 orth = pos->pieceBB[WR+o] | pos->pieceBB[WQ+o];
+    while (orth) {
+        int from = LSB(orth); orth &= orth-1;
+        U64 t = rookAttacks(from, occ) & wanted & checkMask;
+        if (pinned & BIT(from)) t &= lineBB[ksq][from];
+        addTargets(list, from, t, -1);
+        if (firstOnly && list->count) return;
+    }
+
+    // castling: never out of check, path empty, king does not cross attacked squares
+    if (!checkers && (flags & GEN_QUIETS)) {
+        if (canCastle(pos, us, 1)) addMove(list, PACK_MOVE(ksq,ksq+2,MT_CASTLE,0));
+        if (canCastle(pos, us, 0)) addMove(list, PACK_MOVE(ksq,ksq-2,MT_CASTLE,0));
+    }
+}
+
+void generateMoves(const Position *pos, char side, MoveList *list, int flags) {
+    genMoves(pos, side, list, flags);
+    STAT_ADD(ST_GEN_CALLS, 1); STAT_ADD(ST_GEN_MOVES, list->count);
+}
+
+void generateLegalMoves(const Position *pos, char side, MoveList *list) { generateMoves(pos, side, list, GEN_ALL); }
+
+// is the fully specified move pm (type and promotion included) legal for side? Validates
+// just this one move, without generating the list
+int isMoveLegal(const Position *pos, char side, PackedMove pm) {
+    int us = side=='w' ? 0 : 1, o = us ? 6 : 0, from = PM_FROM(pm), to = PM_TO(pm), type = PM_TYPE(pm), ksq = pos->kingSq[us];
+    U64 own = pos->occBB[us], occ = pos->occBB[2];
+    if (pm==NO_MOVE || ksq<0 || from==to || !(own & BIT(from)) || (own & BIT(to)) || (type!=MT_PROMO && PM_PROMO(pm))) return 0;
+    int piece = pieceIndex(pos->board[from/8][from%8]) - o, fwd = us ? 8 : -8, lastRank = us ? 7 : 0;
+    if (type==MT_CASTLE)
+        return piece==WK && to/8==from/8 && (to==from+2 || to==from-2) && !kingAttackedWith(pos, ksq, us, occ, 0) && canCastle(pos, us, to>from);
+    if (type==MT_EP) {
+        int cap = to-fwd;
+        if (piece!=WP || pos->epR<0 || to!=SQ(pos->epR,pos->epC) || !(pawnAtt[us][from] & BIT(to)) || (occ & BIT(to))) return 0;
+        return !kingAttackedWith(pos, ksq, us, (occ ^ BIT(from) ^ BIT(cap)) | BIT(to), BIT(cap));
+    }
+    if ((type==MT_PROMO) != (piece==WP && to/8==lastRank)) return 0;
+    U64 reach;
+    switch (piece) {
+        case WP: reach = pawnAtt[us][from] & pos->occBB[!us];
+                 if (!(occ & BIT(from+fwd))) { reach |= BIT(from+fwd); if (from/8==(us ? 1 : 6) && !(occ & BIT(from+2*fwd))) reach |= BIT(from+2*fwd); }
+                 break;
+        case WN: reach = knightAtt[from]; break;
+        case WB: reach = bishopAttacks(from, occ); break;
+        case WR: reach = rookAttacks(from, occ); break;
+        case WQ: reach = bishopAttacks(from, occ) | rookAttacks(from, occ); break;
+        case WK: return (kingAtt[from] & BIT(to)) && !kingAttackedWith(pos, to, us, (occ ^ BIT(from)) | BIT(to), BIT(to));
+        default: return 0;
+    }
+    return (reach & BIT(to)) && !kingAttackedWith(pos, ksq, us, (occ ^ BIT(from)) | BIT(to), BIT(to));
+}
+
+// the move a player means by from -> to: castling for a two-file king step, en-passant for a
+// pawn onto the ep square, queen promotion on the last rank (legality is isMoveLegal's job)
+PackedMove inputMove(const Position *pos, int fr,int fc,int tr,int tc) {
+    char p = toupper((unsigned char)pos->board[fr][fc]); int from = SQ(fr,fc), to = SQ(tr,tc);
+    if (p=='K' && fr==tr && abs(tc-fc)==2) return PACK_MOVE(from,to,MT_CASTLE,0);
+    if (p=='P' && fc!=tc && tr==pos->epR && tc==pos->epC) return PACK_MOVE(from,to,MT_EP,0);
+    if (p=='P' && (tr==0 || tr==7)) return PACK_MOVE(from,to,MT_PROMO,3);
+    return PACK_MOVE(from,to,MT_NORMAL,0);
+}
+
+/* ===== Make / unmake moves (update halfmove clock, flags) ===== */
+unsigned char packCastleFlags(const Position *pos) {
+    return (unsigned char)(pos->whiteKingMoved | pos->blackKingMoved<<1 | pos->whiteRookA_Moved<<2 |
+                           pos->whiteRookH_Moved<<3 | pos->blackRookA_Moved<<4 | pos->blackRookH_Moved<<5);
+}
+
+void unpackCastleFlags(Position *pos, unsigned char f) {
+    pos->whiteKingMoved = f&1; pos->blackKingMoved = (f>>1)&1; pos->whiteRookA_Moved = (f>>2)&1;
+    pos->whiteRookH_Moved = (f>>3)&1; pos->blackRookA_Moved = (f>>4)&1; pos->blackRookH_Moved = (f>>5)&1;
+}
+
+void makeMoveStruct(Position *pos, Move *m) {
+    STAT_ADD(ST_MAKES, 1);
+    m->movedPiece = pos->board[m->fr][m->fc];
+    m->capturedPiece = pos->board[m->tr][m->tc];
+    m->prevHalfmoveClock = pos->halfmoveClock;
+    m->prevEpR = pos->epR; m->prevEpC = pos->epC;
+    m->prevCastle = packCastleFlags(pos);
+    m->prevKey = pos->key;
+    m->flags = 0;
+    pos->key ^= zobCastle[castleRights(pos)] ^ epKey(pos); // old rights / ep out, new ones in at the end
+    // update halfmove clock
+    if (m->movedPiece=='P' || m->movedPiece=='p' || m->capturedPiece!='.') pos->halfmoveClock = 0; else pos->halfmoveClock++;
+    // detect en-passant capture
+    if ((m->movedPiece=='P' || m->movedPiece=='p') && m->tr==pos->epR && m->tc==pos->epC && m->capturedPiece=='.') {
+        int capR = (m->movedPiece=='P') ? m->tr+1 : m->tr-1;
+        if (validPos(capR,m->tc) && ((m->movedPiece=='P' && pos->board[capR][m->tc]=='p') || (m->movedPiece=='p' && pos->board[capR][m->tc]=='P'))) {
+            m->flags |= MF_EP;
+            m->capturedPiece = pos->board[capR][m->tc];
+            setSquare(pos,capR,m->tc,'.');
+        }
+    }
+    // move (promotion replaces the pawn on arrival)
+    setSquare(pos,m->tr,m->tc,m->promo ? m->promo : m->movedPiece);
+    setSquare(pos,m->fr,m->fc,'.');
+    // castling rook move
+    if (m->movedPiece=='K' && m->fr==7 && m->fc==4 && (m->tc==6 || m->tc==2)) {
+        m->flags |= MF_CASTLE;
+        if (m->tc==6) { setSquare(pos,7,5,pos->board[7][7]); setSquare(pos,7,7,'.'); }
+        else { setSquare(pos,7,3,pos->board[7][0]); setSquare(pos,7,0,'.'); }
+    } else if (m->movedPiece=='k' && m->fr==0 && m->fc==4 && (m->tc==6 || m->tc==2)) {
+        m->flags |= MF_CASTLE;
+        if (m->tc==6) { setSquare(pos,0,5,pos->board[0][7]); setSquare(pos,0,7,'.'); }
+        else { setSquare(pos,0,3,pos->board[0][0]); setSquare(pos,0,0,'.'); }
+    }
+    // update castling flags
+    if (m->movedPiece=='K') pos->whiteKingMoved = 1;
+    if (m->movedPiece=='k') pos->blackKingMoved = 1;
+    if (m->movedPiece=='R' && m->fr==7 && m->fc==0) pos->whiteRookA_Moved = 1;
+    if (m->movedPiece=='R' && m->fr==7 && m->fc==7) pos->whiteRookH_Moved = 1;
+    if (m->movedPiece=='r' && m->fr==0 && m->fc==0) pos->blackRookA_Moved = 1;
+    if (m->movedPiece=='r' && m->fr==0 && m->fc==7) pos->blackRookH_Moved = 1;
+    if (m->capturedPiece=='R' && m->tr==7 && m->tc==0) pos->whiteRookA_Moved = 1;
+    if (m->capturedPiece=='R' && m->tr==7 && m->tc==7) pos->whiteRookH_Moved = 1;
+    if (m->capturedPiece=='r' && m->tr==0 && m->tc==0) pos->blackRookA_Moved = 1;
+    if (m->capturedPiece=='r' && m->tr==0 && m->tc==7) pos->blackRookH_Moved = 1;
+    // handle en-passant target: if pawn moved two squares, set ep square, else clear
+    pos->epR = pos->epC = -1;
+    if (m->movedPiece=='P' && m->fr==6 && m->tr==4) { pos->epR = 5; pos->epC = m->fc; }
+    else if (m->movedPiece=='p' && m->fr==1 && m->tr==3) { pos->epR = 2; pos->epC = m->fc; }
+    if (m->movedPiece>='a' && m->movedPiece<='z') pos->fullmoveNumber++;
+    pos->key ^= zobCastle[castleRights(pos)] ^ epKey(pos) ^ zobSide;
+}
+
+// exact inverse of makeMoveStruct, using only the undo snapshot in m
+void unmakeMove(Position *pos, const Move *m) {
+    STAT_ADD(ST_UNMAKES, 1);
+    setSquare(pos,m->fr,m->fc,m->movedPiece);
+    if (m->flags & MF_EP) { setSquare(pos,m->tr,m->tc,'.'); setSquare(pos,m->fr,m->tc,m->capturedPiece); }
+    else setSquare(pos,m->tr,m->tc,m->capturedPiece);
+    if (m->flags & MF_CASTLE) {
+        int hr = m->fr;
+        if (m->tc==6) { setSquare(pos,hr,7,pos->board[hr][5]); setSquare(pos,hr,5,'.'); }
+        else { setSquare(pos,hr,0,pos->board[hr][3]); setSquare(pos,hr,3,'.'); }
+    }
+    pos->halfmoveClock = m->prevHalfmoveClock;
+    pos->epR = m->prevEpR; pos->epC = m->prevEpC;
+    unpackCastleFlags(pos, m->prevCastle);
+    if (m->movedPiece>='a' && m->movedPiece<='z') pos->fullmoveNumber--;
+    pos->key = m->prevKey;
+}
+
+// hand the move to the other side without moving (null-move pruning); m keeps the undo info
+// the clock restarts so repetition scans never reach back across the null move
+void makeNullMove(Position *pos, Move *m) {
+    m->prevEpR = pos->epR; m->prevEpC = pos->epC; m->prevKey = pos->key; m->prevHalfmoveClock = pos->halfmoveClock;
+    pos->key ^= epKey(pos) ^ zobSide;
+    pos->epR = pos->epC = -1; pos->halfmoveClock = 0;
+}
+
+void unmakeNullMove(Position *pos, const Move *m) {
+    pos->epR = m->prevEpR; pos->epC = m->prevEpC; pos->key = m->prevKey; pos->halfmoveClock = m->prevHalfmoveClock;
+}
+
+// expand a packed move into a Move for makeMoveStruct; the promotion piece takes the mover's color
+Move unpackMove(const Position *pos, PackedMove pm) {
+    int from = PM_FROM(pm), to = PM_TO(pm);
+    Move m = {0}; m.fr = from/8; m.fc = from%8; m.tr = to/8; m.tc = to%8;
+    if (PM_TYPE(pm)==MT_PROMO) { char p = "nbrq"[PM_PROMO(pm)]; m.promo = isupper((unsigned char)pos->board[m.fr][m.fc]) ? toupper(p) : p; }
+    return m;
+}
+
+// apply a packed move; m receives the undo record
+void playMove(Position *pos, PackedMove pm, Move *m) {
+    *m = unpackMove(pos, pm); makeMoveStruct(pos, m);
+}
+
+/* ===== Promotion interactive helper (used by user moves) ===== */
+char askPromotionPiece(int isWhite) {
+    char choice = 'Q';
+    printf("Promosi pion! Pilih (Q/R/B/N): "); fflush(stdout);
+    if (scanf(" %c",&choice)==1) {
+        while (getchar()!='\n');
+        choice = toupper(choice);
+        if (strchr("QRBN",choice)==NULL) choice='Q';
+    } else {
+        while (getchar()!='\n');
+        choice='Q';
+    }
+    return isWhite?choice:tolower(choice);
+}
+
+/* ===== Game record: commit / takeback ===== */
+void setLastMoveHighlight(Game *g, PackedMove pm) {
+    if (pm==NO_MOVE) { g->lastFromR=g->lastFromC=g->lastToR=g->lastToC=-1; return; }
+    g->lastFromR=PM_FROM(pm)/8; g->lastFromC=PM_FROM(pm)%8; g->lastToR=PM_TO(pm)/8; g->lastToC=PM_TO(pm)%8;
+}
+
+// play pm and record it; returns 0 (and plays nothing) when the record is full,
+// since undo and repetition detection rely on every move being in it
+int commitMove(Game *g, PackedMove pm) {
+    if (g->historyCount>=MAX_HISTORY) return 0;
+    playMove(&g->pos, pm, &g->undo[g->historyCount]);
+    setLastMoveHighlight(g, pm);
+    g->moves[g->historyCount] = pm; g->keys[g->historyCount+1] = g->pos.key; g->historyCount++;
+    return 1;
+}
+
+// undo the last committed move; returns 0 when there is nothing to take back
+int takebackMove(Game *g) {
+    if (g->historyCount==0) return 0;
+    g->historyCount--;
+    unmakeMove(&g->pos, &g->undo[g->historyCount]);
+    setLastMoveHighlight(g, g->historyCount>0 ? g->moves[g->historyCount-1] : NO_MOVE);
+    g->gameOver = 0;
+    return 1;
+}
+
+/* ===== Evaluation =====
+   Tapered material + piece-square evaluation (PeSTO values). The mg/eg sums and
+   the game phase live in the Position and are updated by setSquare, so make /
+   unmake keep them current and evaluate() is O(1). Tables are written from
+   white's view with a8 first, matching sq = r*8+c; black uses the mirror sq^56. */
+const int mgValue[6] = { 82, 337, 365, 477, 1025, 0 };
+const int egValue[6] = { 94, 281, 297, 512,  936, 0 };
+
+const int mgTable[6][64] = {
+    { // pawn
+      0,   0,   0,   0,   0,   0,  0,   0,
+     98, 134,  61,  95,  68, 126, 34, -11,
+     -6,   7,  26,  31,  65,  56, 25, -20,
+    -14,  13,   6,  21,  23,  12, 17, -23,
+    -27,  -2,  -5,  12,  17,   6, 10, -25,
+    -26,  -4,  -4, -10,   3,   3, 33, -12,
+    -35,  -1, -20, -23, -15,  24, 38, -22,
+      0,   0,   0,   0,   0,   0,  0,   0 },
+    { // knight
+    -167, -89, -34, -49,  61, -97, -15, -107,
+     -73, -41,  72,  36,  23,  62,   7,  -17,
+     -47,  60,  37,  65,  84, 129,  73,   44,
+      -9,  17,  19,  53,  37,  69,  18,   22,
+     -13,   4,  16,  13,  28,  19,  21,   -8,
+     -23,  -9,  12,  10,  19,  17,  25,  -16,
+     -29, -53, -12,  -3,  -1,  18, -14,  -19,
+    -105, -21, -58, -33, -17, -28, -19,  -23 },
+    { // bishop
+    -29,   4, -82, -37, -25, -42,   7,  -8,
+    -26,  16, -18, -13,  30,  59,  18, -47,
+    -16,  37,  43,  40,  35,  50,  37,  -2,
+     -4,   5,  19,  50,  37,  37,   7,  -2,
+     -6,  13,  13,  26,  34,  12,  10,   4,
+      0,  15,  15,  15,  14,  27,  18,  10,
+      4,  15,  16,   0,   7,  21,  33,   1,
+    -33,  -3, -14, -21, -13, -12, -39, -21 },
+    { // rook
+     32,  42,  32,  51, 63,  9,  31,  43,
+     27,  32,  58,  62, 80, 67,  26,  44,
+     -5,  19,  26,  36, 17, 45,  61,  16,
+    -24, -11,   7,  26, 24, 35,  -8, -20,
+    -36, -26, -12,  -1,  9, -7,   6, -23,
+    -45, -25, -16, -17,  3,  0,  -5, -33,
+    -44, -16, -20,  -9, -1, 11,  -6, -71,
+    -19, -13,   1,  17, 16,  7, -37, -26 },
+    { // queen
+    -28,   0,  29,  12,  59,  44,  43,  45,
+    -24, -39,  -5,   1, -16,  57,  28,  54,
+    -13, -17,   7,   8,  29,  56,  47,  57,
+    -27, -27, -16, -16,  -1,  17,  -2,   1,
+     -9, -26,  -9, -10,  -2,  -4,   3,  -3,
+    -14,   2, -11,  -2,  -5,   2,  14,   5,
+    -35,  -8,  11,   2,   8,  15,  -3,   1,
+     -1, -18,  -9,  10, -15, -25, -31, -50 },
+    { // king
+    -65,  23,  16, -15, -56, -34,   2,  13,
+     29,  -1, -20,  -7,  -8,  -4, -38, -29,
+     -9,  24,   2, -16, -20,   6,  22, -22,
+    -17, -20, -12, -27, -30, -25, -14, -36,
+    -49,  -1, -27, -39, -46, -44, -33, -51,
+    -14, -14, -22, -46, -44, -30, -15, -27,
+      1,   7,  -8, -64, -43, -16,   9,   8,
+    -15,  36,  12, -54,   8, -28,  24,  14 },
+};
+
+const int egTable[6][64] = {
+    { // pawn
+      0,   0,   0,   0,   0,   0,   0,   0,
+    178, 173, 158, 134, 147, 132, 165, 187,
+     94, 100,  85,  67,  56,  53,  82,  84,
+     32,  24,  13,   5,  -2,   4,  17,  17,
+     13,   9,  -3,  -7,  -7,  -8,   3,  -1,
+      4,   7,  -6,   1,   0,  -5,  -1,  -8,
+     13,   8,   8,  10,  13,   0,   2,  -7,
+      0,   0,   0,   0,   0,   0,   0,   0 },
+    { // knight
+    -58, -38, -13, -28, -31, -27, -63, -99,
+    -25,  -8, -25,  -2,  -9, -25, -24, -52,
+    -24, -20,  10,   9,  -1,  -9, -19, -41,
+    -17,   3,  22,  22,  22,  11,   8, -18,
+    -18,  -6,  16,  25,  16,  17,   4, -18,
+    -23,  -3,  -1,  15,  10,  -3, -20, -22,
+    -42, -20, -10,  -5,  -2, -20, -23, -44,
+    -29, -51, -23, -15, -22, -18, -50, -64 },
+    { // bishop
+    -14, -21, -11,  -8, -7,  -9, -17, -24,
+     -8,  -4,   7, -12, -3, -13,  -4, -14,
+      2,  -8,   0,  -1, -2,   6,   0,   4,
+     -3,   9,  12,   9, 14,  10,   3,   2,
+     -6,   3,  13,  19,  7,  10,  -3,  -9,
+    -12,  -3,   8,  10, 13,   3,  -7, -15,
+    -14, -18,  -7,  -1,  4,  -9, -15, -27,
+    -23,  -9, -23,  -5, -9, -16,  -5, -17 },
+    { // rook
+     13, 10, 18, 15, 12,  12,   8,   5,
+     11, 13, 13, 11, -3,   3,   8,   3,
+      7,  7,  7,  5,  4,  -3,  -5,  -3,
+      4,  3, 13,  1,  2,   1,  -1,   2,
+      3,  5,  8,  4, -5,  -6,  -8, -11,
+     -4,  0, -5, -1, -7, -12,  -8, -16,
+     -6, -6,  0,  2, -9,  -9, -11,  -3,
+     -9,  2,  3, -1, -5, -13,   4, -20 },
+    { // queen
+     -9,  22,  22,  27,  27,  19,  10,  20,
+    -17,  20,  32,  41,  58,  25,  30,   0,
+    -20,   6,   9,  49,  47,  35,  19,   9,
+      3,  22,  24,  45,  57,  40,  57,  36,
+    -18,  28,  19,  47,  31,  34,  39,  23,
+    -16, -27,  15,   6,   9,  17,  10,   5,
+    -22, -23, -30, -16, -16, -23, -36, -32,
+    -33, -28, -22, -43,  -5, -32, -20, -41 },
+    { // king
+    -74, -35, -18, -18, -11,  15,   4, -17,
+    -12,  17,  14,  17,  17,  38,  23,  11,
+     10,  17,  23,  15,  20,  45,  44,  13,
+     -8,  22,  24,  27,  26,  33,  26,   3,
+    -18,  -4,  21,  24,  27,  23,   9, -11,
+    -19,  -3,  11,  21,  23,  16,   7,  -9,
+    -27, -11,   4,  13,  14,   4,  -5, -17,
+    -53, -34, -21, -11, -28, -14, -24, -43 },
+};
+
+void initEval() {
+    for (int p=0;p<6;p++) for (int sq=0;sq<64;sq++) {
+        psqMg[p][sq] = mgValue[p] + mgTable[p][sq];       psqEg[p][sq] = egValue[p] + egTable[p][sq];
+        psqMg[p+6][sq] = -(mgValue[p] + mgTable[p][sq^56]); psqEg[p+6][sq] = -(egValue[p] + egTable[p][sq^56]);
+    }
+}
+
+// static evaluation from the side to move's point of view, blended by game phase
+int evaluate(const Position *pos, char side) {
+    int ph = pos->phase>24 ? 24 : pos->phase;
+    int s = (pos->mg*ph + pos->eg*(24-ph)) / 24;
+    return side=='w' ? s : -s;
+}
+
+// material balance in pawns (white positive), straight from the piece counters
+int totalScore(const Position *pos) {
+    const int v[5] = {1,3,3,5,9}; int s = 0;
+    for (int p=0;p<5;p++) s += v[p] * (pos->pieceCount[p] - pos->pieceCount[p+6]);
+    return s;
+}
+
+/* ===== Endgame tablebases =====
+   Distance-to-mate tables for king + queen / rook / pawn against a lone king,
+   built at startup by retrograde analysis: pass n marks the positions that win
+   in n plies (some move reaches a loss in n-1) or lose in n (every move reaches
+   a win, the longest in n-1), until nothing changes. Tables are stored with the
+   strong side as white; pawnless ones use the 8 board symmetries (white king in
+   the a1-d1-d4 triangle), KPK the left-right mirror. Entries: 0 = draw,
+   n > 0 = side to move mates in n plies, -(n+1) = side to move is mated in n. */
+enum { TB_KQK, TB_KRK, TB_KPK, TB_COUNT };
+enum { TB_LOSS = -1, TB_DRAW = 0, TB_WIN = 1, TB_NONE = 2 };
+#define TB_ILLEGAL 127
+#define TB_SIZE(tb) ((tb)==TB_KPK ? 24*64*64*2 : 10*64*64*2)
+signed char *tbTable[TB_COUNT];
+int tbTriIndex[64], tbTriSquare[10];
+atomic_int tbReady;          // set once every table is complete
+
+// swap files and ranks (reflection in the a1-h8 diagonal)
+static inline int tbTranspose(int sq) { return (7-sq%8)*8 + (7-sq/8); }
+
+// canonical index of (white king, black king, white piece, side to move: 0 = white)
+int tbIndex(int tb, int wk, int bk, int x, int stm) {
+    if (tb==TB_KPK) {
+        if (x%8>3) { wk ^= 7; bk ^= 7; x ^= 7; }
+        return (((((x/8)-1)*4 + x%8)*64 + wk)*64 + bk)*2 + stm;
+    }
+    if (wk%8>3) { wk ^= 7; bk ^= 7; x ^= 7; }
+    if (wk/8<4) { wk ^= 56; bk ^= 56; x ^= 56; }
+    if (7-wk/8 > wk%8) { wk = tbTranspose(wk); bk = tbTranspose(bk); x = tbTranspose(x); }
+    return ((tbTriIndex[wk]*64 + bk)*64 + x)*2 + stm;
+}
+
+static inline U64 tbAttacks(int tb, int x, U64 occ) {
+    return tb==TB_KQK ? rookAttacks(x,occ)|bishopAttacks(x,occ) : tb==TB_KRK ? rookAttacks(x,occ) : pawnAtt[0][x];
+}
+
+// children of a position as table values from the child's side to move (captures and
+// minor promotions are draws). Returns the child count, or -1 for an illegal position
+int tbChildren(int tb, int wk, int bk, int x, int stm, signed char *out) {
+    U64 occ = BIT(wk)|BIT(bk)|BIT(x); int n = 0;
+    if (wk==bk || wk==x || bk==x || (kingAtt[wk] & BIT(bk))) return -1;
+    if (tb==TB_KPK && (x<8 || x>=56)) return -1;
+    if (stm==0 && (tbAttacks(tb, x, occ) & BIT(bk))) return -1; // black cannot be in check with white to move
+    if (stm==0) {
+        for (U64 t = kingAtt[wk] & ~kingAtt[bk] & ~BIT(x); t; t &= t-1) out[n++] = tbTable[tb][tbIndex(tb, LSB(t), bk, x, 1)];
+        if (tb!=TB_KPK) {
+            for (U64 t = tbAttacks(tb, x, occ) & ~occ; t; t &= t-1) out[n++] = tbTable[tb][tbIndex(tb, wk, bk, LSB(t), 1)];
+        } else if (!(occ & BIT(x-8))) {
+            if (x-8<8) { // promotion: queen and rook continue in their tables, knight and bishop draw
+                out[n++] = tbTable[TB_KQK][tbIndex(TB_KQK, wk, bk, x-8, 1)];
+                out[n++] = tbTable[TB_KRK][tbIndex(TB_KRK, wk, bk, x-8, 1)];
+                out[n++] = 0; out[n++] = 0;
+            } else {
+                out[n++] = tbTable[tb][tbIndex(tb, wk, bk, x-8, 1)];
+                if (x/8==6 && !(occ & BIT(x-16))) out[n++] = tbTable[tb][tbIndex(tb, wk, bk, x-16, 1)];
+            }
+        }
+    } else {
+        U64 attacked = kingAtt[wk] | tbAttacks(tb, x, BIT(wk)|BIT(x)); // the king does not block its own escape line
+        for (U64 t = kingAtt[bk] & ~attacked; t; t &= t-1) {
+            int to = LSB(t);
+            out[n++] = to==x ? 0 : tbTable[tb][tbIndex(tb, wk, to, x, 0)];
+        }
+    }
+    return n;
+}
+
+// black to move, no moves: mated or stalemated
+static inline int tbBlackInCheck(int tb, int wk, int bk, int x) { return (tbAttacks(tb, x, BIT(wk)|BIT(bk)|BIT(x)) & BIT(bk)) != 0; }
+
+void tbDecode(int tb, int idx, int *wk, int *bk, int *x, int *stm) {
+    *stm = idx&1; idx >>= 1;
+    if (tb==TB_KPK) { *bk = idx&63; *wk = (idx>>6)&63; idx >>= 12; *x = (idx/4+1)*8 + idx%4; }
+    else { *x = idx&63; *bk = (idx>>6)&63; *wk = tbTriSquare[idx>>12]; }
+}
+
+// crossPlies: longest distance in the tables this one leads into; returns its own longest
+int buildTable(int tb, int crossPlies) {
+    int size = TB_SIZE(tb); signed char *v = tbTable[tb], child[64];
+    memset(v, 0, size);
+    for (int idx=0; idx<size; idx++) {
+        int wk, bk, x, stm; tbDecode(tb, idx, &wk, &bk, &x, &stm);
+        int n = tbChildren(tb, wk, bk, x, stm, child);
+        if (n<0) v[idx] = TB_ILLEGAL;
+        else if (n==0 && stm==1 && tbBlackInCheck(tb, wk, bk, x)) v[idx] = -1; // mated: lost in 0 plies
+    }
+    int longestPly = 0;
+    for (int ply=1; ply<TB_ILLEGAL-2; ply++) {
+        int changed = 0;
+        for (int idx=0; idx<size; idx++) {
+            if (v[idx]) continue;
+            int wk, bk, x, stm; tbDecode(tb, idx, &wk, &bk, &x, &stm);
+            int n = tbChildren(tb, wk, bk, x, stm, child), win = 0, allWin = n>0, longest = 0;
+            for (int i=0;i<n;i++) {
+                signed char c = child[i];
+                if (c<0 && -c-1==ply-1) win = 1;
+                if (c>0 && c!=TB_ILLEGAL) { if (c>longest) longest = c; } else allWin = 0;
+            }
+            if (win) { v[idx] = ply; changed = 1; }
+            else if (allWin && longest==ply-1) { v[idx] = -(ply+1); changed = 1; }
+        }
+        if (changed) longestPly = ply;
+        else if (ply>crossPlies+1) break;
+    }
+    return longestPly;
+}
+
+void *tbBuildWorker(void *arg) {
+    (void)arg;
+    int q = buildTable(TB_KQK, 0), r = buildTable(TB_KRK, 0);
+    buildTable(TB_KPK, q>r ? q : r); // promotions lead into the KQK / KRK values
+    atomic_store_explicit(&tbReady, 1, memory_order_release);
+    return NULL;
+}
+
+// allocate the tables (about a quarter of a megabyte) and build them on a background
+// thread, so startup stays instant; probes answer TB_NONE until they are done.
+// Returns 0 when out of memory
+int initTablebases() {
+    int t = 0;
+    for (int sq=0;sq<64;sq++) {
+        int f = sq%8, k = 7-sq/8;
+        tbTriIndex[sq] = -1;
+        if (f<=3 && k<=f) { tbTriIndex[sq] = t; tbTriSquare[t++] = sq; }
+    }
+    for (int tb=0;tb<TB_COUNT;tb++) if (!(tbTable[tb] = malloc(TB_SIZE(tb)))) return 0;
+    pthread_t tid;
+    if (pthread_create(&tid, NULL, tbBuildWorker, NULL)==0) pthread_detach(tid);
+    else tbBuildWorker(NULL);
+    return 1;
+}
+
+// value of king + piece against a bare king from raw squares, for stm (0 = white to move);
+// piece is WQ / WR / WP or a black one, anything else (a lone minor piece) is a draw
+signed char tb3Value(int piece, int wk, int bk, int x, int stm) {
+    static const int tbOf[6] = { TB_KPK, -1, -1, TB_KRK, TB_KQK, -1 };
+    int tb = tbOf[piece%6];
+    if (tb<0) return TB_DRAW;
+    if (piece>=6) { int t = wk; wk = bk^56; bk = t^56; x ^= 56; stm ^= 1; } // black is strong: mirror ranks and colors
+    return tbTable[tb][tbIndex(tb, wk, bk, x, stm)];
+}
+
+/* 4-piece pawnless endings: king + queen or rook against king + a lighter piece.
+   One takes seconds to build, so --make-tb writes them to files once and --tb
+   maps the files read-only at startup. The index is the 3-piece one plus the
+   weak piece; with the white king on the a1-h8 diagonal the reflection in it
+   is applied too, so every position has exactly one index. The generator runs
+   backwards from the mates: unmoving from a position lost in n-1 gives wins in
+   n, and a position is lost once all its distinct children are won, counted
+   down per position. Captures leave the table for the 3-piece values. */
+enum { TB4_KQKR, TB4_KQKB, TB4_KQKN, TB4_KRKB, TB4_KRKN, TB4_COUNT };
+const int tb4Pieces[TB4_COUNT][2] = { {WQ,BR}, {WQ,BB}, {WQ,BN}, {WR,BB}, {WR,BN} };
+const char *tb4Names[TB4_COUNT] = { "kqkr", "kqkb", "kqkn", "krkb", "krkn" };
+#define TB4_SIZE (10*64*64*64*2)
+#define TB4_NOWIN 255        // build: some capture draws or wins, so the position is never lost
+MappedFile tb4File[TB4_COUNT];  // mapped by --tb; data is NULL when the table is not loaded
+
+// canonical index of sq = {white king, black king, white piece, black piece}
+int tb4Index(const int *sq, int stm) {
+    int wk = sq[0], bk = sq[1], x = sq[2], y = sq[3];
+    if (wk%8>3) { wk ^= 7; bk ^= 7; x ^= 7; y ^= 7; }
+    if (wk/8<4) { wk ^= 56; bk ^= 56; x ^= 56; y ^= 56; }
+    if (7-wk/8 > wk%8) { wk = tbTranspose(wk); bk = tbTranspose(bk); x = tbTranspose(x); y = tbTranspose(y); }
+    int idx = (((tbTriIndex[wk]*64 + bk)*64 + x)*64 + y)*2 + stm;
+    if (7-wk/8 == wk%8) {
+        int t = (((tbTriIndex[wk]*64 + tbTranspose(bk))*64 + tbTranspose(x))*64 + tbTranspose(y))*2 + stm;
+        if (t<idx) idx = t;
+    }
+    return idx;
+}
+
+void tb4Decode(int idx, int *sq, int *stm) {
+    *stm = idx&1; idx >>= 1;
+    sq[3] = idx&63; sq[2] = (idx>>6)&63; sq[1] = (idx>>12)&63; sq[0] = tbTriSquare[idx>>18];
+}
+
+static inline U64 tbPieceAttacks(int piece, int sq, U64 occ) {
+    switch (piece%6) {
+        case WN: return knightAtt[sq];
+        case WB: return bishopAttacks(sq, occ);
+        case WR: return rookAttacks(sq, occ);
+        case WQ: return rookAttacks(sq, occ) | bishopAttacks(sq, occ);
+        default: return kingAtt[sq];
+    }
+}
+
+// side s (0 = white) is in check; pieces pc on sq, -1 = captured
+static int tb4InCheck(const int *pc, const int *sq, int s) {
+    U64 occ = 0;
+    for (int i=0;i<4;i++) if (sq[i]>=0) occ |= BIT(sq[i]);
+    if (kingAtt[sq[!s]] & BIT(sq[s])) return 1;
+    return sq[3-s]>=0 && (tbPieceAttacks(pc[3-s], sq[3-s], occ) & BIT(sq[s]));
+}
+
+typedef struct { int idx; signed char v; } Tb4Child; // idx -1: a capture left the table, v is its value
+
+// moves of the side to move; returns the count, or -1 for an illegal position
+int tb4Children(int t, const int *sq, int stm, Tb4Child *out) {
+    const int pc[4] = { WK, BK, tb4Pieces[t][0], tb4Pieces[t][1] };
+    U64 occ = 0; int n = 0;
+    for (int i=0;i<4;i++) { if (occ & BIT(sq[i])) return -1; occ |= BIT(sq[i]); }
+    if (tb4InCheck(pc, sq, !stm)) return -1; // also rejects touching kings
+    U64 own = BIT(sq[stm]) | BIT(sq[2+stm]);
+    for (int m=stm; m<4; m+=2) // the king, then the piece
+        for (U64 to = tbPieceAttacks(pc[m], sq[m], occ) & ~own & ~BIT(sq[!stm]); to; to &= to-1) {
+            int c[4] = { sq[0], sq[1], sq[2], sq[3] }, capture;
+            c[m] = LSB(to); capture = c[m]==sq[3-stm];
+            if (capture) c[3-stm] = -1;
+            if (tb4InCheck(pc, c, stm)) continue;
+            if (capture) { out[n].idx = -1; out[n++].v = tb3Value(pc[2+stm], c[0], c[1], c[2+stm], !stm); }
+            else { out[n].idx = tb4Index(c, !stm); out[n++].v = 0; }
+        }
+    return n;
+}
+
+// distinct indices of the positions one move earlier (the other side moved, not a capture)
+int tb4Parents(int t, const int *sq, int stm, int *out) {
+    const int pc[4] = { WK, BK, tb4Pieces[t][0], tb4Pieces[t][1] };
+    U64 occ = BIT(sq[0]) | BIT(sq[1]) | BIT(sq[2]) | BIT(sq[3]); int n = 0;
+    for (int m=!stm; m<4; m+=2)
+        for (U64 from = tbPieceAttacks(pc[m], sq[m], occ) & ~occ; from; from &= from-1) {
+            int c[4] = { sq[0], sq[1], sq[2], sq[3] };
+            c[m] = LSB(from);
+            if (tb4InCheck(pc, c, stm)) continue; // stm would have been in check with the other side to move
+            int idx = tb4Index(c, !stm), k = 0;
+            while (k<n && out[k]!=idx) k++;
+            if (k==n) out[n++] = idx;
+        }
+    return n;
+}
+
+typedef struct { int *a; int n, cap; } TbList;
+static void tbPush(TbList *l, int x) {
+    if (l->n==l->cap) { l->cap = l->cap ? l->cap*2 : 1024; l->a = realloc(l->a, l->cap*sizeof(int)); }
+    l->a[l->n++] = x;
+}
+
+// build table t into v (TB4_SIZE entries, same encoding as the 3-piece tables) once the
+// 3-piece tables are ready; returns the longest mate in plies, -1 when out of memory
+int buildTable4(int t, signed char *v) {
+    const int pc[4] = { WK, BK, tb4Pieces[t][0], tb4Pieces[t][1] };
+    unsigned char *left = malloc(TB4_SIZE), *ext = malloc(TB4_SIZE); // children not yet won, longest capture win
+    static TbList done[TB_ILLEGAL+1], due[TB_ILLEGAL+1];             // resolved at ply n; captures decide at ply n (idx*2 + lost)
+    if (!left || !ext) { free(left); free(ext); return -1; }
+    Tb4Child ch[64]; int sq[4], stm, kids[64];
+    for (int idx=0; idx<TB4_SIZE; idx++) {
+        tb4Decode(idx, sq, &stm);
+        int n = tb4Index(sq, stm)==idx ? tb4Children(t, sq, stm, ch) : -1, k = 0, fastest = TB_ILLEGAL;
+        v[idx] = 0; left[idx] = 0; ext[idx] = 0;
+        if (n<0) { v[idx] = TB_ILLEGAL; continue; }
+        if (n==0) { ext[idx] = TB4_NOWIN; if (tb4InCheck(pc, sq, stm)) { v[idx] = -1; tbPush(&done[0], idx); } continue; }
+        for (int i=0;i<n;i++) {
+            if (ch[i].idx>=0) { int j = 0; while (j<k && kids[j]!=ch[i].idx) j++; if (j==k) kids[k++] = ch[i].idx; continue; }
+            signed char c = ch[i].v;
+            if (c>0 && c!=TB_ILLEGAL) { if (ext[idx]!=TB4_NOWIN && c>ext[idx]) ext[idx] = c; }
+            else { ext[idx] = TB4_NOWIN; if (c<0 && -c<fastest) fastest = -c; }
+        }
+        left[idx] = k;
+        if (fastest<TB_ILLEGAL) tbPush(&due[fastest], idx*2);  // a capture into a lost position
+        else if (!k && ext[idx]!=TB4_NOWIN) tbPush(&due[ext[idx]+1], idx*2+1); // every move captures into a win
+    }
+    int longest = 0, parents[64];
+    for (int ply=1; ply<TB_ILLEGAL-1; ply++) {
+        TbList *prev = &done[ply-1];
+        for (int i=0;i<prev->n;i++) {
+            int c = prev->a[i], n; tb4Decode(c, sq, &stm);
+            n = tb4Parents(t, sq, stm, parents);
+            for (int j=0;j<n;j++) {
+                int p = parents[j];
+                if (v[p]) continue;
+                if (v[c]<0) { v[p] = ply; tbPush(&done[ply], p); }     // a move into a lost position
+                else if (--left[p]==0 && ext[p]!=TB4_NOWIN) {          // the last child not known to be won
+                    if (ext[p]<ply) { v[p] = -(ply+1); tbPush(&done[ply], p); }
+                    else tbPush(&due[ext[p]+1], p*2+1);
+                }
+            }
+        }
+        for (int i=0;i<due[ply].n;i++) {
+            int p = due[ply].a[i]>>1;
+            if (!v[p]) { v[p] = (due[ply].a[i]&1) ? -(ply+1) : ply; tbPush(&done[ply], p); }
+        }
+        free(prev->a); *prev = (TbList){0}; free(due[ply].a); due[ply] = (TbList){0};
+        if (done[ply].n) longest = ply;
+        int pending = done[ply].n>0;
+        for (int k=ply+1; k<=TB_ILLEGAL && !pending; k++) pending = due[k].n>0;
+        if (!pending) break;
+    }
+    for (int k=0;k<=TB_ILLEGAL;k++) { free(done[k].a); done[k] = (TbList){0}; free(due[k].a); due[k] = (TbList){0}; }
+    free(left); free(ext);
+    return longest;
+}
+
+// map dir/<name>.tb for each 4-piece table found there; returns how many were loaded
+int tbLoad4(const char *dir) {
+    int loaded = 0;
+    for (int t=0;t<TB4_COUNT;t++) {
+        char path[1024]; snprintf(path, sizeof(path), "%s/%s.tb", dir, tb4Names[t]);
+        if (!mapFile(&tb4File[t], path)) continue;
+        if (tb4File[t].size!=TB4_SIZE) { fprintf(stderr, "%s bukan tabel akhir permainan yang sah, dilewati.\n", path); unmapFile(&tb4File[t]); continue; }
+        loaded++;
+    }
+    return loaded;
+}
+
+// the 4-piece value for pos, TB_ILLEGAL when no loaded table has its material
+signed char tb4Value(const Position *pos, int stm) {
+    int pw = -1, pb = -1;
+    for (int p=WP;p<WK;p++) {
+        if (pos->pieceBB[p]) { if (pw>=0 || POPCNT(pos->pieceBB[p])>1) return TB_ILLEGAL; pw = p; }
+        if (pos->pieceBB[p+6]) { if (pb>=0 || POPCNT(pos->pieceBB[p+6])>1) return TB_ILLEGAL; pb = p+6; }
+    }
+    if (pw<0 || pb<0) return TB_ILLEGAL;
+    int x = LSB(pos->pieceBB[pw]), y = LSB(pos->pieceBB[pb]);
+    for (int t=0;t<TB4_COUNT;t++) {
+        if (!tb4File[t].data) continue;
+        if (tb4Pieces[t][0]==pw && tb4Pieces[t][1]==pb) {
+            int sq[4] = { pos->kingSq[0], pos->kingSq[1], x, y };
+            return ((const signed char*)tb4File[t].data)[tb4Index(sq, stm)];
+        }
+        if (tb4Pieces[t][0]==pb-6 && tb4Pieces[t][1]==pw+6) { // black is strong: mirror ranks and colors
+            int sq[4] = { pos->kingSq[1]^56, pos->kingSq[0]^56, y^56, x^56 };
+            return ((const signed char*)tb4File[t].data)[tb4Index(sq, !stm)];
+        }
+    }
+    return TB_ILLEGAL;
+}
+
+// TB_WIN / TB_LOSS / TB_DRAW for the side to move (*plies = distance to mate),
+// TB_NONE unless pos is king + one queen, rook or pawn against a king, or a
+// 4-piece ending whose table is loaded
+int tbProbe(const Position *pos, char side, int *plies) {
+    int count = POPCNT(pos->occBB[2]), stm = side=='w' ? 0 : 1;
+    if ((count!=3 && count!=4) || !atomic_load_explicit(&tbReady, memory_order_acquire) || pos->pieceCount[WK]!=1 || pos->pieceCount[BK]!=1) return TB_NONE;
+    signed char v = TB_ILLEGAL;
+    if (count==4) v = tb4Value(pos, stm);
+    else {
+        static const int strong[6] = { WQ, WR, WP, BQ, BR, BP };
+        for (int i=0;i<6 && v==TB_ILLEGAL;i++)
+            if (pos->pieceBB[strong[i]]) v = tb3Value(strong[i], pos->kingSq[0], pos->kingSq[1], LSB(pos->pieceBB[strong[i]]), stm);
+    }
+    if (v==TB_ILLEGAL) return TB_NONE;
+    *plies = v>0 ? v : v<0 ? -v-1 : 0;
+    return v>0 ? TB_WIN : v<0 ? TB_LOSS : TB_DRAW;
+}
+
+/* ===== Endgame checks (checkmate/stalemate/50-move/insufficient) ===== */
+int inCheck(const Position *pos, char side) {
+    STAT_ADD(ST_CHECK_TESTS, 1);
+    int us = side=='w' ? 0 : 1, ksq = pos->kingSq[us];
+    if (ksq<0) return 0;
+    return (attackersTo(pos, ksq, pos->occBB[2]) & pos->occBB[!us]) != 0;
+}
+
+// answers cached by position key, shared by concurrent games without locks like the TT:
+// check = key ^ occupancy ^ data, so a hit needs the full key, the same occupancy and the
+// same side, and a torn entry fails the check. The answer decides mate and stalemate, so
+// a slot only counts when all of that matches
+#define LEGAL_CACHE_SIZE 4096
+#define LC_ANSWER 1
+#define LC_BLACK  2
+#define LC_USED   4
+typedef struct { _Atomic U64 check, data; } LegalEntry;
+LegalEntry legalCache[LEGAL_CACHE_SIZE];
+
+int hasAnyLegalMove(const Position *pos, char side) {
+    U64 key = pos->key ^ pos->occBB[2], sideBit = side=='b' ? LC_BLACK : 0;
+    LegalEntry *e = &legalCache[pos->key & (LEGAL_CACHE_SIZE-1)];
+    U64 data = atomic_load_explicit(&e->data, memory_order_relaxed), check = atomic_load_explicit(&e->check, memory_order_relaxed);
+    if ((data & LC_USED) && (check ^ data)==key && (data & LC_BLACK)==sideBit) return (int)(data & LC_ANSWER);
+    MoveList ml; generateMoves(pos, side, &ml, GEN_ALL|GEN_FIRST);
+    data = LC_USED | sideBit | (ml.count>0 ? LC_ANSWER : 0);
+    atomic_store_explicit(&e->data, data, memory_order_relaxed); atomic_store_explicit(&e->check, key ^ data, memory_order_relaxed);
+    return ml.count>0;
+}
+
+int insufficientMaterial(const Position *pos){
+    const unsigned char *n = pos->pieceCount;
+    int wP=n[WP],wN=n[WN],wB=n[WB],wR=n[WR],wQ=n[WQ]; int bP=n[BP],bN=n[BN],bB=n[BB],bR=n[BR],bQ=n[BQ];
+    if (wP+bP+wR+bR+wQ+bQ==0) {
+        if (wN+wB==0 && bN+bB==0) return 1;
+        if ((wN+wB==1) && (bN+bB==0)) return 1;
+        if ((bN+bB==1) && (wN+wB==0)) return 1;
+    }
+    return 0;
+}
+
+enum { RESULT_NONE, RESULT_WHITE, RESULT_BLACK, RESULT_DRAW };
+
+// is the game over with side to move? returns RESULT_*; *why gets the reason
+int gameOutcome(const Game *g, char side, const char **why) {
+    const Position *pos = &g->pos;
+    if (pos->kingSq[0]<0) { *why = "Raja putih hilang! HITAM MENANG!"; return RESULT_BLACK; }
+    if (pos->kingSq[1]<0) { *why = "Raja hitam hilang! PUTIH MENANG!"; return RESULT_WHITE; }
+    if (pos->halfmoveClock>=100) { *why = "Draw by 50-move rule"; return RESULT_DRAW; }
+    if (repetitionCount(g->keys, g->historyCount+1, pos->halfmoveClock, 2)>=2) { *why = "Draw by threefold repetition"; return RESULT_DRAW; }
+    if (insufficientMaterial(pos)) { *why = "Draw by insufficient material"; return RESULT_DRAW; }
+    if (hasAnyLegalMove(pos, side)) {
+        if (g->historyCount>=MAX_HISTORY) { *why = "Draw: game record is full"; return RESULT_DRAW; } // no further move can be recorded
+        *why = ""; return RESULT_NONE;
+    }
+    if (!inCheck(pos, side)) { *why = "STALEMATE! DRAW"; return RESULT_DRAW; }
+    if (side=='w') { *why = "CHECKMATE! HITAM MENANG!"; return RESULT_BLACK; }
+    *why = "CHECKMATE! PUTIH MENANG!"; return RESULT_WHITE;
+}
+
+// playerTurn is the side to move; mode 'C' (vs computer) also tells the human the verdict
+void checkGameEndConditionsAndReport(Game *g, char playerTurn, char mode, char playerColor) {
+    const char *why; int res = gameOutcome(g, playerTurn, &why);
+    if (res==RESULT_NONE) return;
+    printf("\n=== %s ===\n", why);
+    if (mode=='C' && res!=RESULT_DRAW) printf((res==RESULT_WHITE) == (playerColor=='w') ? "Kamu menang!\n" : "Kamu kalah!\n");
+    g->gameOver = 1;
+}
+
+/* ===== SAN (standard algebraic notation) ===== */
+// write pm (legal for side in pos) as SAN, e.g. "Nbd7", "exd6", "e8=Q+", "O-O#"
+void moveToSan(const Position *pos, char side, PackedMove pm, char *out) {
+    int from = PM_FROM(pm), to = PM_TO(pm); char *o = out;
+    char piece = toupper((unsigned char)pos->board[from/8][from%8]);
+    int capture = pos->board[to/8][to%8]!='.' || PM_TYPE(pm)==MT_EP;
+    if (PM_TYPE(pm)==MT_CASTLE) o += sprintf(o, to%8==6 ? "O-O" : "O-O-O");
+    else {
+        if (piece=='P') { if (capture) { *o++ = 'a'+from%8; *o++ = 'x'; } }
+        else {
+            *o++ = piece;
+            // disambiguate between same-type pieces reaching the same square: file, else rank, else both
+            MoveList ml; generateLegalMoves(pos, side, &ml); int sameFile = 0, sameRank = 0, others = 0;
+            for (int i=0;i<ml.count;i++) {
+                int f = PM_FROM(ml.moves[i]);
+                if (f==from || PM_TO(ml.moves[i])!=to || toupper((unsigned char)pos->board[f/8][f%8])!=piece) continue;
+                others++; sameFile |= f%8==from%8; sameRank |= f/8==from/8;
+            }
+            if (others) {
+                if (!sameFile) *o++ = 'a'+from%8;
+                else if (!sameRank) *o++ = '0'+8-from/8;
+                else { *o++ = 'a'+from%8; *o++ = '0'+8-from/8; }
+            }
+            if (capture) *o++ = 'x';
+        }
+        *o++ = 'a'+to%8; *o++ = '0'+8-to/8;
+        if (PM_TYPE(pm)==MT_PROMO) { *o++ = '='; *o++ = toupper((unsigned char)"nbrq"[PM_PROMO(pm)]); }
+    }
+    Position next = *pos; Move m; playMove(&next, pm, &m); char opp = side=='w' ? 'b' : 'w';
+    if (inCheck(&next, opp)) *o++ = hasAnyLegalMove(&next, opp) ? '+' : '#';
+    *o = '\0';
+}
+
+// the legal move written as SAN (long algebraic such as "Ng1f3" works too); NO_MOVE when
+// it is malformed, illegal or ambiguous. Check marks and !? annotations are ignored
+PackedMove parseSan(const Position *pos, char side, const char *san) {
+    char buf[16]; int n = 0;
+    for (const char *p=san; *p && n<15; p++) if (!strchr("+#!?", *p)) buf[n++] = *p;
+    buf[n] = '\0';
+    MoveList ml; generateLegalMoves(pos, side, &ml);
+    if (!strcmp(buf,"O-O") || !strcmp(buf,"0-0") || !strcmp(buf,"O-O-O") || !strcmp(buf,"0-0-0")) {
+        int tc = n==5 ? 2 : 6;
+        for (int i=0;i<ml.count;i++) if (PM_TYPE(ml.moves[i])==MT_CASTLE && PM_TO(ml.moves[i])%8==tc) return ml.moves[i];
+        return NO_MOVE;
+    }
+    // [piece] [from file] [from rank] [x] to-square [=promotion]
+    int promo = -1;
+    if (n>=3 && strchr("NBRQnbrq", buf[n-1])) { promo = (int)(strchr("nbrq", tolower((unsigned char)buf[n-1]))-"nbrq"); n--; if (buf[n-1]=='=') n--; }
+    if (n<2) return NO_MOVE;
+    int tf = buf[n-2]-'a', tr = '8'-buf[n-1];
+    if (tf<0 || tf>7 || tr<0 || tr>7) return NO_MOVE;
+    char piece = 'P'; int i = 0, ff = -1, fr = -1;
+    if (strchr("NBRQK", buf[0])) piece = buf[i++];
+    for (; i<n-2; i++) {
+        if (buf[i]>='a' && buf[i]<='h') ff = buf[i]-'a';
+        else if (buf[i]>='1' && buf[i]<='8') fr = '8'-buf[i];
+        else if (buf[i]!='x' && buf[i]!='-' && buf[i]!=':') return NO_MOVE;
+    }
+    PackedMove found = NO_MOVE; int matches = 0;
+    for (int k=0;k<ml.count;k++) {
+        PackedMove m = ml.moves[k]; int from = PM_FROM(m);
+        if (PM_TO(m)!=SQ(tr,tf) || toupper((unsigned char)pos->board[from/8][from%8])!=piece) continue;
+        if ((ff>=0 && from%8!=ff) || (fr>=0 && from/8!=fr)) continue;
+        if ((PM_TYPE(m)==MT_PROMO) != (promo>=0) || (promo>=0 && PM_PROMO(m)!=promo)) continue;
+        found = m; matches++;
+    }
+    return matches==1 ? found : NO_MOVE;
+}
+
+/* ===== Search engine =====
+   Negamax alpha-beta with iterative deepening, aspiration windows, null-move
+   pruning and late-move reductions, bounded by a time and/or node budget.
+   Everything a search mutates lives in its SearchThread; the transposition
+   table and the stop flag of its SearchGroup are the only shared state (Lazy
+   SMP: helper threads run the same search at staggered depths and meet through
+   the table). Independent groups can search at the same time. */
+#define INF_SCORE 32000
+#define MATE_SCORE 30000
+#define MAX_PLY 64
+#define MATE_BOUND (MATE_SCORE-MAX_PLY)  // scores beyond this are "mate in n"
+#define OPP(s) ((s)=='w' ? 'b' : 'w')
+#define MAX_THREADS 128
+
+#ifdef _WIN32
+long long nowMs() { return (long long)GetTickCount64(); }
+void sleepMs(int ms) { Sleep(ms); }
+int cpuCount() { SYSTEM_INFO si; GetSystemInfo(&si); return (int)si.dwNumberOfProcessors; }
+#else
+long long nowMs() { struct timespec ts; clock_gettime(CLOCK_MONOTONIC, &ts); return ts.tv_sec*1000LL + ts.tv_nsec/1000000; }
+void sleepMs(int ms) { struct timespec ts = { ms/1000, (ms%1000)*1000000L }; nanosleep(&ts, NULL); }
+int cpuCount() { long n = sysconf(_SC_NPROCESSORS_ONLN); return n>0 ? (int)n : 1; }
+#endif
+
+typedef struct {
+    int moveTimeMs;       // 0 = no time limit
+    long long nodeLimit;  // 0 = no node limit
+    int maxDepth;         // 0 = up to MAX_PLY
+    int verbose;          // print one info line per finished iteration
+    int threads;          // Lazy SMP workers, 1 = single-threaded
+} SearchLimits;
+
+typedef struct SearchThread {
+    struct SearchGroup *group;
+    int id;                           // 0 = main thread (reports, checks limits)
+    Position pos; char side;          // side to move at the current node
+    _Atomic long long nodes;          // written only by its own thread, summed by the main one
+    int completedDepth, bestScore;
+    PackedMove bestMove;
+    PackedMove pv[MAX_PLY][MAX_PLY]; int pvLen[MAX_PLY];
+    U64 keyStack[MAX_HISTORY+MAX_PLY]; int keyCount; // game keys up to the root, then the search path
+    PackedMove killers[MAX_PLY][2];   // quiet moves that last caused a cutoff at each ply
+    int history[2][64][64];           // quiet move success by side, from, to
+} SearchThread;
+
+// one search: its workers, limits, clock and stop flag, and the table they share
+typedef struct SearchGroup {
+    SearchLimits limits; long long startMs;
+    atomic_int stop;
+    atomic_int pondering;    // set: searching on the opponent's time, the limits do not apply yet
+    void (*onIteration)(const SearchThread *t, void *ctx); void *iterCtx; // main thread, after each finished iteration
+    TransTable *tt;
+    SearchThread *threads; int threadCount, maxThreads;
+} SearchGroup;
+
+atomic_int searchAbort;      // stop request from outside the search (UCI "stop" / "quit")
+SearchThread searchThreads[MAX_THREADS]; // large (pv tables), keep them off the stack
+SearchGroup mainSearch = { .tt = &mainTT, .threads = searchThreads, .threadCount = 1, .maxThreads = MAX_THREADS };
+
+// a group with its own table for a concurrent search; NULL when out of memory
+SearchGroup *newSearchGroup(int maxThreads, size_t ttMb) {
+    SearchGroup *sg = calloc(1, sizeof(SearchGroup));
+    if (!sg) return NULL;
+    sg->threads = calloc(maxThreads, sizeof(SearchThread)); sg->tt = calloc(1, sizeof(TransTable));
+    if (!sg->threads || !sg->tt || !ttResize(sg->tt, ttMb)) { free(sg->threads); free(sg->tt); free(sg); return NULL; }
+    sg->maxThreads = maxThreads; sg->threadCount = 1;
+    return sg;
+}
+
+void freeSearchGroup(SearchGroup *sg) { if (!sg) return; ttFree(sg->tt); free(sg->tt); free(sg->threads); free(sg); }
+
+static inline int stopped(const SearchThread *t) { return atomic_load_explicit(&t->group->stop, memory_order_relaxed); }
+
+// plain load + store: each counter has a single writer, so no locked add is needed
+static inline long long bumpNodes(SearchThread *t) {
+    long long n = atomic_load_explicit(&t->nodes, memory_order_relaxed) + 1;
+    atomic_store_explicit(&t->nodes, n, memory_order_relaxed);
+    return n;
+}
+
+long long totalNodes(const SearchGroup *sg) {
+    long long n = 0;
+    for (int i=0;i<sg->threadCount;i++) n += atomic_load_explicit(&sg->threads[i].nodes, memory_order_relaxed);
+    return n;
+}
+
+int pieceValue[12] = {100,320,330,500,900,0, 100,320,330,500,900,0}; // move ordering only
+int seeValue[6] = {100,320,330,500,900,20000};
+
+int hasNonPawnMaterial(const Position *pos, char side) {
+    int base = side=='w' ? 0 : 6;
+    return (pos->pieceBB[base+WN] | pos->pieceBB[base+WB] | pos->pieceBB[base+WR] | pos->pieceBB[base+WQ]) != 0;
+}
+
+// mate scores are stored relative to the node, not the root
+int scoreToTT(int s, int ply) { return s>=MATE_BOUND ? s+ply : s<=-MATE_BOUND ? s-ply : s; }
+int scoreFromTT(int s, int ply) { return s>=MATE_BOUND ? s-ply : s<=-MATE_BOUND ? s+ply : s; }
+
+void checkLimits(const SearchThread *t) {
+    SearchGroup *sg = t->group;
+    if (t->completedDepth<1) return; // always finish depth 1 so there is a move to play
+    if (atomic_load_explicit(&searchAbort, memory_order_relaxed) || (!atomic_load_explicit(&sg->pondering, memory_order_relaxed) &&
+        ((sg->limits.nodeLimit && totalNodes(sg) >= sg->limits.nodeLimit) ||
+         (sg->limits.moveTimeMs && nowMs()-sg->startMs >= sg->limits.moveTimeMs)))) atomic_store(&sg->stop, 1);
+}
+
+// static exchange evaluation: material won (negative: lost) by the side making the
+// capture or promotion m once both sides have traded off on its target square, each
+// always recapturing with its least valuable attacker. Sliders behind the traded
+// pieces join in because the attackers are recomputed with the shrinking occupancy
+int see(const Position *pos, PackedMove m) {
+    int from = PM_FROM(m), to = PM_TO(m), type = PM_TYPE(m), gain[32], d = 0;
+    int mover = pieceIndex(pos->board[from/8][from%8]), side = mover>=6 ? 0 : 1; // side: who recaptures next
+    int victim = type==MT_EP ? WP : pieceIndex(pos->board[to/8][to%8]);
+    int attacker = type==MT_PROMO ? WN+PM_PROMO(m) : mover%6;
+    U64 occ = pos->occBB[2], fromBit = BIT(from);
+    gain[0] = (victim>=0 ? seeValue[victim%6] : 0) + (type==MT_PROMO ? seeValue[attacker]-seeValue[WP] : 0);
+    if (type==MT_EP) occ ^= BIT(to + (side ? 8 : -8)); // the captured pawn is behind the target square
+    do {
+        d++;
+        gain[d] = seeValue[attacker] - gain[d-1]; // what the other side nets by recapturing
+        if ((-gain[d-1] > gain[d] ? -gain[d-1] : gain[d]) < 0) break; // neither side can improve
+        occ ^= fromBit;
+        U64 att = attackersTo(pos, to, occ) & occ & pos->occBB[side];
+        fromBit = 0;
+        for (int p=WP;p<=WK && att;p++) {
+            U64 b = att & pos->pieceBB[p + side*6];
+            if (!b) continue;
+            // the king may only take last, on an undefended square
+            if (p==WK && (attackersTo(pos, to, occ) & occ & pos->occBB[!side])) break;
+            fromBit = b & -b; attacker = p; break;
+        }
+        side = !side;
+    } while (fromBit && d<31);
+    while (--d) gain[d-1] = -(-gain[d-1] > gain[d] ? -gain[d-1] : gain[d]);
+    return gain[0];
+}
+
+/* Staged move picker: the TT move first, then captures and queen promotions by
+   MVV-LVA (those losing material by SEE are held back), then the killers, then
+   quiet moves by history, and finally the held-back captures and underpromotions.
+   Each stage is generated only once the previous one is used up, so a cutoff by
+   the TT move or a capture never pays for generating the quiet moves. With
+   noisyOnly (quiescence) it stops after the captures and drops the losing ones. */
+enum { PICK_TT, PICK_GEN_CAPTURES, PICK_CAPTURES, PICK_KILLERS, PICK_GEN_QUIETS, PICK_QUIETS, PICK_BAD, PICK_DONE };
+
+typedef struct {
+    int stage, idx, killerIdx, noisyOnly;
+    const Position *pos; char side; const SearchThread *t;
+    PackedMove ttMove, killers[2];
+    MoveList list; int scores[MAX_MOVES];
+    MoveList bad;                     // losing captures and underpromotions, tried last
+} MovePicker;
+
+void initPicker(MovePicker *mp, const SearchThread *t, const Position *pos, char side, PackedMove ttMove, int ply, int noisyOnly) {
+    mp->pos = pos; mp->side = side; mp->t = t; mp->idx = mp->killerIdx = 0; mp->bad.count = 0; mp->noisyOnly = noisyOnly;
+    mp->ttMove = (ttMove && isMoveLegal(pos, side, ttMove)) ? ttMove : NO_MOVE;
+    mp->killers[0] = t->killers[ply][0]; mp->killers[1] = t->killers[ply][1];
+    mp->stage = mp->ttMove ? PICK_TT : PICK_GEN_CAPTURES;
+}
+
+static inline int isQuietMove(const Position *pos, PackedMove m) {
+    return PM_TYPE(m)!=MT_PROMO && PM_TYPE(m)!=MT_EP && pos->board[PM_TO(m)/8][PM_TO(m)%8]=='.';
+}
+
+// best remaining move of the current stage list, by lazy selection sort
+static PackedMove pickBest(MovePicker *mp) {
+    MoveList *ml = &mp->list; int i = mp->idx, best = i;
+    for (int j=i+1;j<ml->count;j++) if (mp->scores[j]>mp->scores[best]) best = j;
+    PackedMove m = ml->moves[best]; ml->moves[best] = ml->moves[i]; mp->scores[best] = mp->scores[i];
+    mp->idx++;
+    return m;
+}
+
+// next move to search, or NO_MOVE when every legal move has been handed out
+PackedMove nextMove(MovePicker *mp) {
+    const Position *pos = mp->pos; PackedMove m;
+    switch (mp->stage) {
+    case PICK_TT:
+        mp->stage = PICK_GEN_CAPTURES;
+        return mp->ttMove;
+    case PICK_GEN_CAPTURES:
+        generateMoves(pos, mp->side, &mp->list, GEN_CAPTURES); mp->idx = 0;
+        for (int i=0;i<mp->list.count;i++) {
+            m = mp->list.moves[i];
+            int victim = PM_TYPE(m)==MT_EP ? WP : pieceIndex(pos->board[PM_TO(m)/8][PM_TO(m)%8]);
+            mp->scores[i] = (victim>=0 ? pieceValue[victim]*10 : 0) - pieceValue[pieceIndex(pos->board[PM_FROM(m)/8][PM_FROM(m)%8])]/10
+                          + (PM_TYPE(m)==MT_PROMO ? pieceValue[WN+PM_PROMO(m)] : 0);
+        }
+        mp->stage = PICK_CAPTURES; // fall through
+    case PICK_CAPTURES:
+        while (mp->idx < mp->list.count) {
+            m = pickBest(mp);
+            if (m==mp->ttMove) continue;
+            if (PM_TYPE(m)==MT_PROMO && PM_PROMO(m)!=3) { if (!mp->noisyOnly) addMove(&mp->bad, m); continue; }
+            // SEE only when the attacker is worth more than its victim
+            int victim = PM_TYPE(m)==MT_EP ? WP : pieceIndex(pos->board[PM_TO(m)/8][PM_TO(m)%8]);
+            int attacker = pieceIndex(pos->board[PM_FROM(m)/8][PM_FROM(m)%8]);
+            if (PM_TYPE(m)!=MT_PROMO && victim>=0 && pieceValue[attacker%6]>pieceValue[victim%6] && see(pos, m)<0) { if (!mp->noisyOnly) addMove(&mp->bad, m); continue; }
+            return m;
+        }
+        if (mp->noisyOnly) { mp->stage = PICK_DONE; return NO_MOVE; }
+        mp->stage = PICK_KILLERS; // fall through
+    case PICK_KILLERS:
+        while (mp->killerIdx < 2) {
+            m = mp->killers[mp->killerIdx++];
+            if (m && m!=mp->ttMove && (mp->killerIdx==1 || m!=mp->killers[0]) && isQuietMove(pos, m) && isMoveLegal(pos, mp->side, m)) return m;
+        }
+        mp->stage = PICK_GEN_QUIETS; // fall through
+    case PICK_GEN_QUIETS: {
+        generateMoves(pos, mp->side, &mp->list, GEN_QUIETS); mp->idx = 0;
+        const int (*h)[64] = mp->t->history[mp->side=='w' ? 0 : 1];
+        for (int i=0;i<mp->list.count;i++) mp->scores[i] = h[PM_FROM(mp->list.moves[i])][PM_TO(mp->list.moves[i])];
+        mp->stage = PICK_QUIETS;
+    } // fall through
+    case PICK_QUIETS:
+        while (mp->idx < mp->list.count) {
+            m = pickBest(mp);
+            if (m!=mp->ttMove && m!=mp->killers[0] && m!=mp->killers[1]) return m;
+        }
+        mp->stage = PICK_BAD; mp->idx = 0; // fall through
+    case PICK_BAD:
+        if (mp->idx < mp->bad.count) return mp->bad.moves[mp->idx++];
+        mp->stage = PICK_DONE; // fall through
+    default:
+        return NO_MOVE;
+    }
+}
+
+/* Quiescence search: at the horizon only captures and promotions are played
+   until the position is quiet, so the static evaluation is never taken in the
+   middle of an exchange. The side to move may stand pat on the evaluation
+   (captures are optional); captures that lose material by SEE, and captures that
+   cannot lift the score to alpha even with a margin (delta pruning), are skipped.
+   At its first ply a side in check plays every evasion instead. */
+#define DELTA_MARGIN 200
+
+int qsearch(SearchThread *t, int alpha, int beta, int ply, int qply) {
+    Position *pos = &t->pos; char side = t->side;
+    t->pvLen[ply] = 0;
+    if ((bumpNodes(t) & 1023)==0 && t->id==0) checkLimits(t);
+    if (stopped(t)) return 0;
+    if (ply>=MAX_PLY-1) return evaluate(pos, side);
+    int check = qply==0 && inCheck(pos, side), best = -INF_SCORE, standPat = 0;
+    if (!check) {
+        best = standPat = evaluate(pos, side);
+        if (standPat>=beta) return standPat;
+        if (standPat>alpha) alpha = standPat;
+    }
+    MovePicker mp; initPicker(&mp, t, pos, side, NO_MOVE, ply, !check);
+    PackedMove pm; int searched = 0;
+    while ((pm = nextMove(&mp))!=NO_MOVE) {
+        if (!check && PM_TYPE(pm)!=MT_PROMO) {
+            int victim = PM_TYPE(pm)==MT_EP ? WP : pieceIndex(pos->board[PM_TO(pm)/8][PM_TO(pm)%8]);
+            if (standPat + pieceValue[victim] + DELTA_MARGIN <= alpha) continue;
+        }
+        searched++;
+        Move m; playMove(pos, pm, &m); t->side = OPP(side);
+        int sc = -qsearch(t, -beta, -alpha, ply+1, qply+1);
+        unmakeMove(pos, &m); t->side = side;
+        if (stopped(t)) return 0;
+        if (sc>best) {
+            best = sc;
+            if (sc>alpha) { alpha = sc; if (alpha>=beta) break; }
+        }
+    }
+    if (check && !searched) return -MATE_SCORE+ply; // checkmated
+    return best;
+}
+
+// history with gravity: scores saturate near +-HISTORY_MAX instead of overflowing
+#define HISTORY_MAX 16384
+static inline void updateHistory(int *h, int bonus) { *h += bonus - *h * (bonus<0 ? -bonus : bonus) / HISTORY_MAX; }
+
+int search(SearchThread *t, int alpha, int beta, int depth, int ply, int allowNull) {
+    Position *pos = &t->pos; char side = t->side;
+    int pvNode = beta-alpha > 1;
+    t->pvLen[ply] = 0;
+    if ((bumpNodes(t) & 1023)==0 && t->id==0) checkLimits(t);
+    if (stopped(t)) return 0;
+    if (ply>0 && (pos->halfmoveClock>=100 || repetitionCount(t->keyStack, t->keyCount, pos->halfmoveClock, 1))) return 0;
+    // three or four pieces left: the tablebase knows the exact result
+    int tbPlies, tb;
+    if (ply>0 && POPCNT(pos->occBB[2])<=4 && (tb = tbProbe(pos, side, &tbPlies))!=TB_NONE)
+        return tb==TB_WIN ? MATE_SCORE-ply-tbPlies : tb==TB_LOSS ? -MATE_SCORE+ply+tbPlies : 0;
+    if (ply>=MAX_PLY-1) return evaluate(pos, side);
+    if (depth<=0) return qsearch(t, alpha, beta, ply, 0);
+    int check = inCheck(pos, side);
+    if (check) depth++; // check extension
+
+    TTHit hit; PackedMove ttMove = NO_MOVE;
+    if (ttProbe(t->group->tt, pos->key, &hit)) {
+        ttMove = hit.move;
+        int ts = scoreFromTT(hit.score, ply);
+        if (!pvNode && hit.depth>=depth && (hit.bound==TT_EXACT || (hit.bound==TT_LOWER && ts>=beta) || (hit.bound==TT_UPPER && ts<=alpha))) { STAT_ADD(ST_TT_CUTOFFS, 1); return ts; }
+    }
 
-void addGenMove(int fr,int fc,int tr,int tc,char promo) {
-    if (genCount < MAX_MOVES) { genList[genCount].fr=fr; genList[genCount].fc=fc; genList[genCount].tr=tr; genList[genCount].tc=tc; genList[genCount].promo=promo; genCount++; }
-}
+    // null move: if passing still fails high, a real move will too
+    if (!pvNode && !check && allowNull && depth>=3 && hasNonPawnMaterial(pos, side) && evaluate(pos, side)>=beta) {
+        Move nm; int R = 2 + depth/4;
+        makeNullMove(pos, &nm); t->side = OPP(side); t->keyStack[t->keyCount++] = pos->key;
+        int sc = -search(t, -beta, -beta+1, depth-1-R, ply+1, 0);
+        unmakeNullMove(pos, &nm); t->side = side; t->keyCount--;
+        if (stopped(t)) return 0;
+        if (sc>=beta) return sc>=MATE_BOUND ? beta : sc;
+    }
 
-void generateLegalMoves(char side) {
-    genCount = 0;
-    for (int r=0;r<8;r++) for (int c=0;c<8;c++) {
-        char p = board[r][c]; if (p=='.') continue;
-        if (side=='w' && !(p>='A' && p<='Z')) continue;
-        if (side=='b' && !(p>='a' && p<='z')) continue;
-        for (int tr=0; tr<8; tr++) for (int tc=0; tc<8; tc++) {
-            if (!isLegalPatternMove(r,c,tr,tc)) {
-                // handle en-passant pattern: when target is ep square and pattern is pawn diagonal and target currently empty
-                if ((p=='P' || p=='p') && epR!=-1 && tr==epR && tc==epC && (tr==r-1 || tr==r+1) && abs(tc-c)==1 && board[tr][tc]=='.') {
-                    // proceed (will fully verify later)
-                } else continue;
-            }
-            // handle pawn promotions separately
-            if ((p=='P' && tr==0) || (p=='p' && tr==7)) {
-                char promos[4] = { (isupper(p)?'Q':'q'), (isupper(p)?'R':'r'), (isupper(p)?'B':'b'), (isupper(p)?'N':'n') };
-                for (int k=0;k<4;k++) {
-                    // simulate promotion and king-safety
-                    char savedFrom = board[r][c], savedTo = board[tr][tc];
-                    board[tr][tc] = promos[k]; board[r][c] = '.';
-                    int kingSafe = 1;
-                    char king = isupper(savedFrom)?'K':'k'; int kr=-1,kc=-1;
-                    for (int rr=0;rr<8;rr++) for (int cc=0;cc<8;cc++) if (board[rr][cc]==king) { kr=rr; kc=cc; }
-                    if (kr!=-1) kingSafe = !isSquareAttacked(kr,kc, isupper(savedFrom)?'b':'w');
-                    board[r][c]=savedFrom; board[tr][tc]=savedTo;
-                    if (kingSafe) addGenMove(r,c,tr,tc,promos[k]);
-                }
-                continue;
-            }
-            // en-passant verification
-            int isEP = 0;
-            if ((p=='P' || p=='p') && epR!=-1 && tr==epR && tc==epC && board[tr][tc]=='.' && abs(tc-c)==1 && ((p=='P' && tr==r-1) || (p=='p' && tr==r+1))) {
-                int capR = (p=='P') ? tr+1 : tr-1;
-                if (validPos(capR,tc) && ((p=='P' && board[capR][tc]=='p') || (p=='p' && board[capR][tc]=='P'))) {
-                    isEP = 1;
-                } else continue;
-            }
-            // handle castling pattern (king moves two squares)
-            if ((p=='K' && r==7 && c==4 && (tr==7 && (tc==6 || tc==2))) ||
-                (p=='k' && r==0 && c==4 && (tr==0 && (tc==6 || tc==2)))) {
-                if (p=='K') {
-                    if (whiteKingMoved) continue;
-                    if (tc==6) { if (whiteRookH_Moved) continue; if (board[7][5]!='.'||board[7][6]!='.') continue; if (board[7][7]!='R') continue;
-                                 if (isSquareAttacked(7,4,'b')||isSquareAttacked(7,5,'b')||isSquareAttacked(7,6,'b')) continue; }
-                    else { if (whiteRookA_Moved) continue; if (board[7][3]!='.'||board[7][2]!='.'||board[7][1]!='.') continue; if (board[7][0]!='R') continue;
-                           if (isSquareAttacked(7,4,'b')||isSquareAttacked(7,3,'b')||isSquareAttacked(7,2,'b')) continue; }
-                } else {
-                    if (blackKingMoved) continue;
-                    if (tc==6) { if (blackRookH_Moved) continue; if (board[0][5]!='.'||board[0][6]!='.') continue; if (board[0][7]!='r') continue;
-                                 if (isSquareAttacked(0,4,'w')||isSquareAttacked(0,5,'w')||isSquareAttacked(0,6,'w')) continue; }
-                    else { if (blackRookA_Moved) continue; if (board[0][3]!='.'||board[0][2]!='.'||board[0][1]!='.') continue; if (board[0][0]!='r') continue;
-                           if (isSquareAttacked(0,4,'w')||isSquareAttacked(0,3,'w')||isSquareAttacked(0,2,'w')) continue; }
-                }
-            }
-            // Now test king safety by simulating (include castling rook move and en-passant captured pawn)
-            int leaves = 0;
-            char savedFrom = board[r][c], savedTo = board[tr][tc];
-            char epCaptured = '.';
-            int capR=-1, capC=-1;
-            if (isEP) {
-                capR = (savedFrom=='P') ? tr+1 : tr-1;
-                capC = tc;
-                epCaptured = board[capR][capC];
-                board[capR][capC] = '.';
+    MovePicker mp; initPicker(&mp, t, pos, side, ttMove, ply, 0);
+    PackedMove quietsTried[MAX_MOVES]; int nQuiets = 0;
+    int best = -INF_SCORE, origAlpha = alpha, i = 0; PackedMove bestMove = NO_MOVE, pm;
+    for (; (pm = nextMove(&mp))!=NO_MOVE; i++) {
+        int quiet = isQuietMove(pos, pm);
+        Move m; playMove(pos, pm, &m); t->side = OPP(side); t->keyStack[t->keyCount++] = pos->key;
+        int sc;
+        if (i==0) sc = -search(t, -beta, -alpha, depth-1, ply+1, 1);
+        else {
+            // late quiet moves get a reduced null-window search first
+            int R = 0;
+            if (depth>=3 && i>=3 && quiet && mp.stage>PICK_KILLERS && !check && !inCheck(pos, t->side)) {
+                R = 1 + (i>=8) + (depth>=8) - pvNode;
+                R = R>depth-2 ? depth-2 : R<0 ? 0 : R;
             }
-            board[tr][tc] = board[r][c]; board[r][c] = '.';
-            int castRfrom=-1, castCfrom=-1, castRto=-1, castCto=-1;
-            if ((savedFrom=='K' && r==7 && c==4 && (tr==7 && (tc==6 || tc==2))) ||
-                (savedFrom=='k' && r==0 && c==4 && (tr==0 && (tc==6 || tc==2)))) {
-                if (savedFrom=='K') {
-                    if (tc==6) { castRfrom=7; castCfrom=7; castRto=7; castCto=5; }
-                    else { castRfrom=7; castCfrom=0; castRto=7; castCto=3; }
-                } else {
-                    if (tc==6) { castRfrom=0; castCfrom=7; castRto=0; castCto=5; }
-                    else { castRfrom=0; castCfrom=0; castRto=0; castCto=3; }
-                }
-                if (castRfrom!=-1) {
-                    board[castRto][castCto] = board[castRfrom][castCfrom];
-                    board[castRfrom][castCfrom] = '.';
+            sc = -search(t, -alpha-1, -alpha, depth-1-R, ply+1, 1);
+            if (sc>alpha && R>0) sc = -search(t, -alpha-1, -alpha, depth-1, ply+1, 1);
+            if (sc>alpha && sc<beta) sc = -search(t, -beta, -alpha, depth-1, ply+1, 1);
+        }
+        unmakeMove(pos, &m); t->side = side; t->keyCount--;
+        if (stopped(t)) return 0;
+        if (sc>best) {
+            best = sc; bestMove = pm;
+            if (sc>alpha) {
+                alpha = sc;
+                t->pv[ply][0] = pm;
+                memcpy(&t->pv[ply][1], t->pv[ply+1], t->pvLen[ply+1]*sizeof(PackedMove));
+                t->pvLen[ply] = t->pvLen[ply+1]+1;
+                if (alpha>=beta) {
+                    // a quiet cutoff becomes a killer; rewarded in history, the quiets before it penalised
+                    if (quiet) {
+                        int (*h)[64] = t->history[side=='w' ? 0 : 1], bonus = depth*depth>400 ? 400 : depth*depth;
+                        if (t->killers[ply][0]!=pm) { t->killers[ply][1] = t->killers[ply][0]; t->killers[ply][0] = pm; }
+                        updateHistory(&h[PM_FROM(pm)][PM_TO(pm)], bonus*16);
+                        for (int q=0;q<nQuiets;q++) updateHistory(&h[PM_FROM(quietsTried[q])][PM_TO(quietsTried[q])], -bonus*16);
+                    }
+                    break;
                 }
             }
-            // find mover king
-            char king = isupper(savedFrom)?'K':'k';
-            int kr=-1,kc=-1;
-            for (int rr=0;rr<8;rr++) for (int cc=0;cc<8;cc++) if (board[rr][cc]==king) { kr=rr; kc=cc; }
-            if (kr==-1) leaves = 1; else {
-                if (isSquareAttacked(kr,kc, isupper(savedFrom)?'b':'w')) leaves = 1;
-            }
-            // undo
-            if (castRfrom!=-1) {
-                board[castRfrom][castCfrom] = board[castRto][castCto];
-                board[castRto][castCto] = '.';
-            }
-            board[r][c] = savedFrom; board[tr][tc] = savedTo;
-            if (isEP && capR!=-1) board[capR][capC] = epCaptured;
-            if (!leaves) {
-                addGenMove(r,c,tr,tc, 0);
-            }
         }
+        if (quiet) quietsTried[nQuiets++] = pm;
     }
+    if (best==-INF_SCORE) return check ? -MATE_SCORE+ply : 0; // nothing searched: no legal move
+    ttStore(t->group->tt, pos->key, depth, best>=beta ? TT_LOWER : best>origAlpha ? TT_EXACT : TT_UPPER, scoreToTT(best, ply), bestMove);
+    return best;
 }
 
-/* ===== Make / unmake moves (update halfmove clock, flags) ===== */
-void makeMoveStruct(Move *m) {
-    m->movedPiece = board[m->fr][m->fc];
-    m->capturedPiece = board[m->tr][m->tc];
-    m->prevHalfmoveClock = halfmoveClock;
-    // update halfmove clock
-    if (m->movedPiece=='P' || m->movedPiece=='p' || m->capturedPiece!='.') halfmoveClock = 0; else halfmoveClock++;
-    // detect en-passant capture
-    int isEP = 0;
-    if ((m->movedPiece=='P' || m->movedPiece=='p') && m->tr==epR && m->tc==epC && m->capturedPiece=='.') {
-        int capR = (m->movedPiece=='P') ? m->tr+1 : m->tr-1;
-        if (validPos(capR,m->tc) && ((m->movedPiece=='P' && board[capR][m->tc]=='p') || (m->movedPiece=='p' && board[capR][m->tc]=='P'))) {
-            isEP = 1;
-            m->capturedPiece = board[capR][m->tc];
-            board[capR][m->tc] = '.';
+void printSearchInfo(const SearchThread *t, int depth, int score) {
+    long long ms = nowMs()-t->group->startMs;
+    printf("info depth %d score ", depth);
+    if (score>=MATE_BOUND) printf("mate %d", (MATE_SCORE-score+1)/2);
+    else if (score<=-MATE_BOUND) printf("mate -%d", (MATE_SCORE+score)/2);
+    else printf("cp %d", score);
+    long long nodes = totalNodes(t->group);
+    printf(" nodes %lld nps %lld time %lld pv", nodes, ms>0 ? nodes*1000/ms : nodes, ms);
+    for (int i=0;i<t->pvLen[0];i++) { char mv[8]; moveToStr(t->pv[0][i], mv); printf(" %s", mv); }
+    printf("\n"); fflush(stdout);
+}
+
+// Lazy SMP depth staggering: helper i skips every other block of depths, with
+// block size and phase varying per helper, so they are rarely on the same depth
+const int skipSize[20]  = {1,1,2,2,2,2,3,3,3,3,3,3,4,4,4,4,4,4,4,4};
+const int skipPhase[20] = {0,1,0,1,2,3,0,1,2,3,4,5,0,1,2,3,4,5,6,7};
+
+// iterative deepening loop run by every thread
+void iterativeDeepening(SearchThread *t) {
+    const SearchLimits *lim = &t->group->limits;
+    int maxDepth = (lim->maxDepth>0 && lim->maxDepth<MAX_PLY) ? lim->maxDepth : MAX_PLY-1, prev = 0;
+    for (int depth=1; depth<=maxDepth; depth++) {
+        if (t->id>0) { int k = (t->id-1)%20; if (((depth+skipPhase[k])/skipSize[k]) % 2) continue; }
+        // aspiration window around the previous score, widened on failure
+        int delta = 40, alpha = -INF_SCORE, beta = INF_SCORE, sc;
+        if (depth>=4) { alpha = prev-delta; beta = prev+delta; }
+        while (1) {
+            sc = search(t, alpha, beta, depth, 0, 0);
+            if (stopped(t)) break;
+            if (sc<=alpha) { alpha = (sc-delta > -INF_SCORE) ? sc-delta : -INF_SCORE; delta *= 2; }
+            else if (sc>=beta) { beta = (sc+delta < INF_SCORE) ? sc+delta : INF_SCORE; delta *= 2; }
+            else break;
         }
+        if (stopped(t)) break; // unfinished iteration is discarded
+        prev = sc; t->completedDepth = depth; t->bestScore = sc;
+        if (t->pvLen[0]>0) t->bestMove = t->pv[0][0];
+        if (t->id>0) continue;
+        if (t->group->onIteration) t->group->onIteration(t, t->group->iterCtx);
+        if (lim->verbose) printSearchInfo(t, depth, sc);
+        if (sc>=MATE_BOUND || sc<=-MATE_BOUND) break;
+        // another iteration would take several times longer than everything so far
+        if (lim->moveTimeMs && !atomic_load(&t->group->pondering) && nowMs()-t->group->startMs >= lim->moveTimeMs/2) break;
     }
-    // move
-    board[m->tr][m->tc] = board[m->fr][m->fc];
-    board[m->fr][m->fc] = '.';
-    // castling rook move
-    if (m->movedPiece=='K' && m->fr==7 && m->fc==4 && (m->tc==6 || m->tc==2)) {
-        if (m->tc==6) { board[7][5] = board[7][7]; board[7][7] = '.'; }
-        else { board[7][3] = board[7][0]; board[7][0] = '.'; }
-    } else if (m->movedPiece=='k' && m->fr==0 && m->fc==4 && (m->tc==6 || m->tc==2)) {
-        if (m->tc==6) { board[0][5] = board[0][7]; board[0][7] = '.'; }
-        else { board[0][3] = board[0][0]; board[0][0] = '.'; }
-    }
-    // update castling flags
-    if (m->movedPiece=='K') whiteKingMoved = 1;
-    if (m->movedPiece=='k') blackKingMoved = 1;
-    if (m->movedPiece=='R' && m->fr==7 && m->fc==0) whiteRookA_Moved = 1;
-    if (m->movedPiece=='R' && m->fr==7 && m->fc==7) whiteRookH_Moved = 1;
-    if (m->movedPiece=='r' && m->fr==0 && m->fc==0) blackRookA_Moved = 1;
-    if (m->movedPiece=='r' && m->fr==0 && m->fc==7) blackRookH_Moved = 1;
-    if (m->capturedPiece=='R' && m->tr==7 && m->tc==0) whiteRookA_Moved = 1;
-    if (m->capturedPiece=='R' && m->tr==7 && m->tc==7) whiteRookH_Moved = 1;
-    if (m->capturedPiece=='r' && m->tr==0 && m->tc==0) blackRookA_Moved = 1;
-    if (m->capturedPiece=='r' && m->tr==0 && m->tc==7) blackRookH_Moved = 1;
-    // handle en-passant target: if pawn moved two squares, set ep square, else clear
-    epR = epC = -1;
-    if (m->movedPiece=='P' && m->fr==6 && m->tr==4) { epR = 5; epC = m->fc; }
-    else if (m->movedPiece=='p' && m->fr==1 && m->tr==3) { epR = 2; epC = m->fc; }
-    // promotion handling: caller should set promoted piece into board after calling makeMoveStruct if needed
 }
 
-/* ===== Promotion interactive helper (used by user moves) ===== */
-char askPromotionPiece(int isWhite) {
-    char choice = 'Q';
-    printf("Promosi pion! Pilih (Q/R/B/N): "); fflush(stdout);
-    if (scanf(" %c",&choice)==1) {
-        while (getchar()!='\n');
-        choice = toupper(choice);
-        if (strchr("QRBN",choice)==NULL) choice='Q';
-    } else {
-        while (getchar()!='\n');
-        choice='Q';
+void *searchWorker(void *arg) { iterativeDeepening((SearchThread*)arg); return NULL; }
+
+// search driver; keys[0..nkeys-1] are the game's position keys ending with the root
+// (NULL if unknown). Returns 0 when the side to move has no legal move
+int searchBestMove(SearchGroup *sg, const Position *root, char side, const U64 *keys, int nkeys, const SearchLimits *lim, PackedMove *bestOut, int *scoreOut) {
+    MoveList rootMoves; generateLegalMoves(root, side, &rootMoves);
+    if (rootMoves.count==0) return 0;
+    *bestOut = rootMoves.moves[0]; if (scoreOut) *scoreOut = 0;
+    if (rootMoves.count==1) { // forced, nothing to think about; callers still read the counters
+        sg->threadCount = 1; atomic_store(&sg->threads[0].nodes, 0); sg->threads[0].completedDepth = 0;
+        return 1;
     }
-    return isWhite?choice:tolower(choice);
+    sg->limits = *lim; sg->startMs = nowMs(); atomic_store(&sg->stop, 0);
+    sg->threadCount = lim->threads<1 ? 1 : lim->threads>sg->maxThreads ? sg->maxThreads : lim->threads;
+    for (int i=0;i<sg->threadCount;i++) {
+        SearchThread *t = &sg->threads[i];
+        t->group = sg; t->id = i; t->pos = *root; t->side = side; atomic_store(&t->nodes, 0);
+        t->completedDepth = 0; t->bestScore = 0; t->bestMove = rootMoves.moves[0];
+        memset(t->killers, 0, sizeof(t->killers));
+        for (int c=0;c<2;c++) for (int f=0;f<64;f++) for (int k=0;k<64;k++) t->history[c][f][k] /= 2; // older games count less
+        // only the reversible tail of the game can repeat
+        int from = (keys && nkeys>0) ? nkeys-1-root->halfmoveClock : 0; if (from<0) from = 0;
+        t->keyCount = 0;
+        if (keys && nkeys>0) for (int k=from;k<nkeys;k++) t->keyStack[t->keyCount++] = keys[k];
+        else t->keyStack[t->keyCount++] = root->key;
+    }
+    ttNewSearch(sg->tt);
+    // helpers run until the main thread raises the stop flag
+    pthread_t tids[MAX_THREADS]; int started = 0;
+    pthread_attr_t attr; pthread_attr_init(&attr); pthread_attr_setstacksize(&attr, 8u<<20);
+    for (int i=1;i<sg->threadCount;i++) { if (pthread_create(&tids[i], &attr, searchWorker, &sg->threads[i])!=0) break; started = i; }
+    pthread_attr_destroy(&attr);
+    iterativeDeepening(&sg->threads[0]);
+    atomic_store(&sg->stop, 1);
+    for (int i=1;i<=started;i++) pthread_join(tids[i], NULL);
+    // take the deepest finished iteration; a helper may have got one further than the main thread
+    const SearchThread *best = &sg->threads[0];
+    for (int i=1;i<=started;i++) {
+        const SearchThread *t = &sg->threads[i];
+        if (t->completedDepth>best->completedDepth && t->bestScore>=best->bestScore) best = t;
+    }
+    *bestOut = best->bestMove; if (scoreOut) *scoreOut = best->bestScore;
+    STAT_ADD(ST_NODES, totalNodes(sg));
+    return 1;
 }
 
-/* ===== History record ===== */
-void recordHistory(int fr,int fc,int tr,int tc) {
-    if (historyCount < MAX_HISTORY) {
-        snprintf(history[historyCount],32, "%c%d-%c%d", 'a'+fc, 8-fr, 'a'+tc, 8-tr);
-        historyCount++;
-    }
+/* ===== Opening book =====
+   Polyglot .bin layout: 16-byte big-endian entries {key, move, weight, learn},
+   sorted by key. The file is memory-mapped, never read in, so opening even a
+   large book is instant, and a probe is a binary search touching a few pages.
+   Entries are keyed by the standard Polyglot hash, computed separately from
+   Position.key (which stays the engine's own key for the TT), so existing
+   Polyglot books work and books from --make-book work in other programs. */
+typedef struct { MappedFile file; const unsigned char *data; size_t entries; } Book;
+
+Book openingBook;            // used by computerMove and UCI mode when loaded
+
+// Polyglot Random64, from the format specification: 768 piece-square entries at
+// 64*kind + 8*row + file (kind = 2*type + white, type p n b r q k, row 0 = rank 1),
+// castling K Q k q at 768, ep file at 772, white to move at 780
+const U64 POLYGLOT_RANDOM[781] = {
+    0x9D39247E33776D41ULL, 0x2AF7398005AAA5C7ULL, 0x44DB015024623547ULL, 0x9C15F73E62A76AE2ULL,
+    0x75834465489C0C89ULL, 0x3290AC3A203001BFULL, 0x0FBBAD1F61042279ULL, 0xE83A908FF2FB60CAULL,
+    0x0D7E765D58755C10ULL, 0x1A083822CEAFE02DULL, 0x9605D5F0E25EC3B0ULL, 0xD021FF5CD13A2ED5ULL,
+    0x40BDF15D4A672E32ULL, 0x011355146FD56395ULL, 0x5DB4832046F3D9E5ULL, 0x239F8B2D7FF719CCULL,
+    0x05D1A1AE85B49AA1ULL, 0x679F848F6E8FC971ULL, 0x7449BBFF801FED0BULL, 0x7D11CDB1C3B7ADF0ULL,
+    0x82C7709E781EB7CCULL, 0xF3218F1C9510786CULL, 0x331478F3AF51BBE6ULL, 0x4BB38DE5E7219443ULL,
+    0xAA649C6EBCFD50FCULL, 0x8DBD98A352AFD40BULL, 0x87D2074B81D79217ULL, 0x19F3C751D3E92AE1ULL,
+    0xB4AB30F062B19ABFULL, 0x7B0500AC42047AC4ULL, 0xC9452CA81A09D85DULL, 0x24AA6C514DA27500ULL,
+    0x4C9F34427501B447ULL, 0x14A68FD73C910841ULL, 0xA71B9B83461CBD93ULL, 0x03488B95B0F1850FULL,
+    0x637B2B34FF93C040ULL, 0x09D1BC9A3DD90A94ULL, 0x3575668334A1DD3BULL, 0x735E2B97A4C45A23ULL,
+    0x18727070F1BD400BULL, 0x1FCBACD259BF02E7ULL, 0xD310A7C2CE9B6555ULL, 0xBF983FE0FE5D8244ULL,
+    0x9F74D14F7454A824ULL, 0x51EBDC4AB9BA3035ULL, 0x5C82C505DB9AB0FAULL, 0xFCF7FE8A3430B241ULL,
+    0x3253A729B9BA3DDEULL, 0x8C74C368081B3075ULL, 0xB9BC6C87167C33E7ULL, 0x7EF48F2B83024E20ULL,
+    0x11D505D4C351BD7FULL, 0x6568FCA92C76A243ULL, 0x4DE0B0F40F32A7B8ULL, 0x96D693460CC37E5DULL,
+    0x42E240CB63689F2FULL, 0x6D2BDCDAE2919661ULL, 0x42880B0236E4D951ULL, 0x5F0F4A5898171BB6ULL,
+    0x39F890F579F92F88ULL, 0x93C5B5F47356388BULL, 0x63DC359D8D231B78ULL, 0xEC16CA8AEA98AD76ULL,
+    0x5355F900C2A82DC7ULL, 0x07FB9F855A997142ULL, 0x5093417AA8A7ED5EULL, 0x7BCBC38DA25A7F3CULL,
+    0x19FC8A768CF4B6D4ULL, 0x637A7780DECFC0D9ULL, 0x8249A47AEE0E41F7ULL, 0x79AD695501E7D1E8ULL,
+    0x14ACBAF4777D5776ULL, 0xF145B6BECCDEA195ULL, 0xDABF2AC8201752FCULL, 0x24C3C94DF9C8D3F6ULL,
+    0xBB6E2924F03912EAULL, 0x0CE26C0B95C980D9ULL, 0xA49CD132BFBF7CC4ULL, 0xE99D662AF4243939ULL,
+    0x27E6AD7891165C3FULL, 0x8535F040B9744FF1ULL, 0x54B3F4FA5F40D873ULL, 0x72B12C32127FED2BULL,
+    0xEE954D3C7B411F47ULL, 0x9A85AC909A24EAA1ULL, 0x70AC4CD9F04F21F5ULL, 0xF9B89D3E99A075C2ULL,
+    0x87B3E2B2B5C907B1ULL, 0xA366E5B8C54F48B8ULL, 0xAE4A9346CC3F7CF2ULL, 0x1920C04D47267BBDULL,
+    0x87BF02C6B49E2AE9ULL, 0x092237AC237F3859ULL, 0xFF07F64EF8ED14D0ULL, 0x8DE8DCA9F03CC54EULL,
+    0x9C1633264DB49C89ULL, 0xB3F22C3D0B0B38EDULL, 0x390E5FB44D01144BULL, 0x5BFEA5B4712768E9ULL,
+    0x1E1032911FA78984ULL, 0x9A74ACB964E78CB3ULL, 0x4F80F7A035DAFB04ULL, 0x6304D09A0B3738C4ULL,
+    0x2171E64683023A08ULL, 0x5B9B63EB9CEFF80CULL, 0x506AACF489889342ULL, 0x1881AFC9A3A701D6ULL,
+    0x6503080440750644ULL, 0xDFD395339CDBF4A7ULL, 0xEF927DBCF00C20F2ULL, 0x7B32F7D1E03680ECULL,
+    0xB9FD7620E7316243ULL, 0x05A7E8A57DB91B77ULL, 0xB5889C6E15630A75ULL, 0x4A750A09CE9573F7ULL,
+    0xCF464CEC899A2F8AULL, 0xF538639CE705B824ULL, 0x3C79A0FF5580EF7FULL, 0xEDE6C87F8477609DULL,
+    0x799E81F05BC93F31ULL, 0x86536B8CF3428A8CULL, 0x97D7374C60087B73ULL, 0xA246637CFF328532ULL,
+    0x043FCAE60CC0EBA0ULL, 0x920E449535DD359EULL, 0x70EB093B15B290CCULL, 0x73A1921916591CBDULL,
+    0x56436C9FE1A1AA8DULL, 0xEFAC4B70633B8F81ULL, 0xBB215798D45DF7AFULL, 0x45F20042F24F1768ULL,
+    0x930F80F4E8EB7462ULL, 0xFF6712FFCFD75EA1ULL, 0xAE623FD67468AA70ULL, 0xDD2C5BC84BC8D8FCULL,
+    0x7EED120D54CF2DD9ULL, 0x22FE545401165F1CULL, 0xC91800E98FB99929ULL, 0x808BD68E6AC10365ULL,
+    0xDEC468145B7605F6ULL, 0x1BEDE3A3AEF53302ULL, 0x43539603D6C55602ULL, 0xAA969B5C691CCB7AULL,
+    0xA87832D392EFEE56ULL, 0x65942C7B3C7E11AEULL, 0xDED2D633CAD004F6ULL, 0x21F08570F420E565ULL,
+    0xB415938D7DA94E3CULL, 0x91B859E59ECB6350ULL, 0x10CFF333E0ED804AULL, 0x28AED140BE0BB7DDULL,
+    0xC5CC1D89724FA456ULL, 0x5648F680F11A2741ULL, 0x2D255069F0B7DAB3ULL, 0x9BC5A38EF729ABD4ULL,
+    0xEF2F054308F6A2BCULL, 0xAF2042F5CC5C2858ULL, 0x480412BAB7F5BE2AULL, 0xAEF3AF4A563DFE43ULL,
+    0x19AFE59AE451497FULL, 0x52593803DFF1E840ULL, 0xF4F076E65F2CE6F0ULL, 0x11379625747D5AF3ULL,
+    0xBCE5D2248682C115ULL, 0x9DA4243DE836994FULL, 0x066F70B33FE09017ULL, 0x4DC4DE189B671A1CULL,
+    0x51039AB7712457C3ULL, 0xC07A3F80C31FB4B4ULL, 0xB46EE9C5E64A6E7CULL, 0xB3819A42ABE61C87ULL,
+    0x21A007933A522A20ULL, 0x2DF16F761598AA4FULL, 0x763C4A1371B368FDULL, 0xF793C46702E086A0ULL,
+    0xD7288E012AEB8D31ULL, 0xDE336A2A4BC1C44BULL, 0x0BF692B38D079F23ULL, 0x2C604A7A177326B3ULL,
+    0x4850E73E03EB6064ULL, 0xCFC447F1E53C8E1BULL, 0xB05CA3F564268D99ULL, 0x9AE182C8BC9474E8ULL,
+    0xA4FC4BD4FC5558CAULL, 0xE755178D58FC4E76ULL, 0x69B97DB1A4C03DFEULL, 0xF9B5B7C4ACC67C96ULL,
+    0xFC6A82D64B8655FBULL, 0x9C684CB6C4D24417ULL, 0x8EC97D2917456ED0ULL, 0x6703DF9D2924E97EULL,
+    0xC547F57E42A7444EULL, 0x78E37644E7CAD29EULL, 0xFE9A44E9362F05FAULL, 0x08BD35CC38336615ULL,
+    0x9315E5EB3A129ACEULL, 0x94061B871E04DF75ULL, 0xDF1D9F9D784BA010ULL, 0x3BBA57B68871B59DULL,
+    0xD2B7ADEEDED1F73FULL, 0xF7A255D83BC373F8ULL, 0xD7F4F2448C0CEB81ULL, 0xD95BE88CD210FFA7ULL,
+    0x336F52F8FF4728E7ULL, 0xA74049DAC312AC71ULL, 0xA2F61BB6E437FDB5ULL, 0x4F2A5CB07F6A35B3ULL,
+    0x87D380BDA5BF7859ULL, 0x16B9F7E06C453A21ULL, 0x7BA2484C8A0FD54EULL, 0xF3A678CAD9A2E38CULL,
+    0x39B0BF7DDE437BA2ULL, 0xFCAF55C1BF8A4424ULL, 0x18FCF680573FA594ULL, 0x4C0563B89F495AC3ULL,
+    0x40E087931A00930DULL, 0x8CFFA9412EB642C1ULL, 0x68CA39053261169FULL, 0x7A1EE967D27579E2ULL,
+    0x9D1D60E5076F5B6FULL, 0x3810E399B6F65BA2ULL, 0x32095B6D4AB5F9B1ULL, 0x35CAB62109DD038AULL,
+    0xA90B24499FCFAFB1ULL, 0x77A225A07CC2C6BDULL, 0x513E5E634C70E331ULL, 0x4361C0CA3F692F12ULL,
+    0xD941ACA44B20A45BULL, 0x528F7C8602C5807BULL, 0x52AB92BEB9613989ULL, 0x9D1DFA2EFC557F73ULL,
+    0x722FF175F572C348ULL, 0x1D1260A51107FE97ULL, 0x7A249A57EC0C9BA2ULL, 0x04208FE9E8F7F2D6ULL,
+    0x5A110C6058B920A0ULL, 0x0CD9A497658A5698ULL, 0x56FD23C8F9715A4CULL, 0x284C847B9D887AAEULL,
+    0x04FEABFBBDB619CBULL, 0x742E1E651C60BA83ULL, 0x9A9632E65904AD3CULL, 0x881B82A13B51B9E2ULL,
+    0x506E6744CD974924ULL, 0xB0183DB56FFC6A79ULL, 0x0ED9B915C66ED37EULL, 0x5E11E86D5873D484ULL,
+    0xF678647E3519AC6EULL, 0x1B85D488D0F20CC5ULL, 0xDAB9FE6525D89021ULL, 0x0D151D86ADB73615ULL,
+    0xA865A54EDCC0F019ULL, 0x93C42566AEF98FFBULL, 0x99E7AFEABE000731ULL, 0x48CBFF086DDF285AULL,
+    0x7F9B6AF1EBF78BAFULL, 0x58627E1A149BBA21ULL, 0x2CD16E2ABD791E33ULL, 0xD363EFF5F0977996ULL,
+    0x0CE2A38C344A6EEDULL, 0x1A804AADB9CFA741ULL, 0x907F30421D78C5DEULL, 0x501F65EDB3034D07ULL,
+    0x37624AE5A48FA6E9ULL, 0x957BAF61700CFF4EULL, 0x3A6C27934E31188AULL, 0xD49503536ABCA345ULL,
+    0x088E049589C432E0ULL, 0xF943AEE7FEBF21B8ULL, 0x6C3B8E3E336139D3ULL, 0x364F6FFA464EE52EULL,
+    0xD60F6DCEDC314222ULL, 0x56963B0DCA418FC0ULL, 0x16F50EDF91E513AFULL, 0xEF1955914B609F93ULL,
+    0x565601C0364E3228ULL, 0xECB53939887E8175ULL, 0xBAC7A9A18531294BULL, 0xB344C470397BBA52ULL,
+    0x65D34954DAF3CEBDULL, 0xB4B81B3FA97511E2ULL, 0xB422061193D6F6A7ULL, 0x071582401C38434DULL,
+    0x7A13F18BBEDC4FF5ULL, 0xBC4097B116C524D2ULL, 0x59B97885E2F2EA28ULL, 0x99170A5DC3115544ULL,
+    0x6F423357E7C6A9F9ULL, 0x325928EE6E6F8794ULL, 0xD0E4366228B03343ULL, 0x565C31F7DE89EA27ULL,
+    0x30F5611484119414ULL, 0xD873DB391292ED4FULL, 0x7BD94E1D8E17DEBCULL, 0xC7D9F16864A76E94ULL,
+    0x947AE053EE56E63CULL, 0xC8C93882F9475F5FULL, 0x3A9BF55BA91F81CAULL, 0xD9A11FBB3D9808E4ULL,
+    0x0FD22063EDC29FCAULL, 0xB3F256D8ACA0B0B9ULL, 0xB03031A8B4516E84ULL, 0x35DD37D5871448AFULL,
+    0xE9F6082B05542E4EULL, 0xEBFAFA33D7254B59ULL, 0x9255ABB50D532280ULL, 0xB9AB4CE57F2D34F3ULL,
+    0x693501D628297551ULL, 0xC62C58F97DD949BFULL, 0xCD454F8F19C5126AULL, 0xBBE83F4ECC2BDECBULL,
+    0xDC842B7E2819E230ULL, 0xBA89142E007503B8ULL, 0xA3BC941D0A5061CBULL, 0xE9F6760E32CD8021ULL,
+    0x09C7E552BC76492FULL, 0x852F54934DA55CC9ULL, 0x8107FCCF064FCF56ULL, 0x098954D51FFF6580ULL,
+    0x23B70EDB1955C4BFULL, 0xC330DE426430F69DULL, 0x4715ED43E8A45C0AULL, 0xA8D7E4DAB780A08DULL,
+    0x0572B974F03CE0BBULL, 0xB57D2E985E1419C7ULL, 0xE8D9ECBE2CF3D73FULL, 0x2FE4B17170E59750ULL,
+    0x11317BA87905E790ULL, 0x7FBF21EC8A1F45ECULL, 0x1725CABFCB045B00ULL, 0x964E915CD5E2B207ULL,
+    0x3E2B8BCBF016D66DULL, 0xBE7444E39328A0ACULL, 0xF85B2B4FBCDE44B7ULL, 0x49353FEA39BA63B1ULL,
+    0x1DD01AAFCD53486AULL, 0x1FCA8A92FD719F85ULL, 0xFC7C95D827357AFAULL, 0x18A6A990C8B35EBDULL,
+    0xCCCB7005C6B9C28DULL, 0x3BDBB92C43B17F26ULL, 0xAA70B5B4F89695A2ULL, 0xE94C39A54A98307FULL,
+    0xB7A0B174CFF6F36EULL, 0xD4DBA84729AF48ADULL, 0x2E18BC1AD9704A68ULL, 0x2DE0966DAF2F8B1CULL,
+    0xB9C11D5B1E43A07EULL, 0x64972D68DEE33360ULL, 0x94628D38D0C20584ULL, 0xDBC0D2B6AB90A559ULL,
+    0xD2733C4335C6A72FULL, 0x7E75D99D94A70F4DULL, 0x6CED1983376FA72BULL, 0x97FCAACBF030BC24ULL,
+    0x7B77497B32503B12ULL, 0x8547EDDFB81CCB94ULL, 0x79999CDFF70902CBULL, 0xCFFE1939438E9B24ULL,
+    0x829626E3892D95D7ULL, 0x92FAE24291F2B3F1ULL, 0x63E22C147B9C3403ULL, 0xC678B6D860284A1CULL,
+    0x5873888850659AE7ULL, 0x0981DCD296A8736DULL, 0x9F65789A6509A440ULL, 0x9FF38FED72E9052FULL,
+    0xE479EE5B9930578CULL, 0xE7F28ECD2D49EECDULL, 0x56C074A581EA17FEULL, 0x5544F7D774B14AEFULL,
+    0x7B3F0195FC6F290FULL, 0x12153635B2C0CF57ULL, 0x7F5126DBBA5E0CA7ULL, 0x7A76956C3EAFB413ULL,
+    0x3D5774A11D31AB39ULL, 0x8A1B083821F40CB4ULL, 0x7B4A38E32537DF62ULL, 0x950113646D1D6E03ULL,
+    0x4DA8979A0041E8A9ULL, 0x3BC36E078F7515D7ULL, 0x5D0A12F27AD310D1ULL, 0x7F9D1A2E1EBE1327ULL,
+    0xDA3A361B1C5157B1ULL, 0xDCDD7D20903D0C25ULL, 0x36833336D068F707ULL, 0xCE68341F79893389ULL,
+    0xAB9090168DD05F34ULL, 0x43954B3252DC25E5ULL, 0xB438C2B67F98E5E9ULL, 0x10DCD78E3851A492ULL,
+    0xDBC27AB5447822BFULL, 0x9B3CDB65F82CA382ULL, 0xB67B7896167B4C84ULL, 0xBFCED1B0048EAC50ULL,
+    0xA9119B60369FFEBDULL, 0x1FFF7AC80904BF45ULL, 0xAC12FB171817EEE7ULL, 0xAF08DA9177DDA93DULL,
+    0x1B0CAB936E65C744ULL, 0xB559EB1D04E5E932ULL, 0xC37B45B3F8D6F2BAULL, 0xC3A9DC228CAAC9E9ULL,
+    0xF3B8B6675A6507FFULL, 0x9FC477DE4ED681DAULL, 0x67378D8ECCEF96CBULL, 0x6DD856D94D259236ULL,
+    0xA319CE15B0B4DB31ULL, 0x073973751F12DD5EULL, 0x8A8E849EB32781A5ULL, 0xE1925C71285279F5ULL,
+    0x74C04BF1790C0EFEULL, 0x4DDA48153C94938AULL, 0x9D266D6A1CC0542CULL, 0x7440FB816508C4FEULL,
+    0x13328503DF48229FULL, 0xD6BF7BAEE43CAC40ULL, 0x4838D65F6EF6748FULL, 0x1E152328F3318DEAULL,
+    0x8F8419A348F296BFULL, 0x72C8834A5957B511ULL, 0xD7A023A73260B45CULL, 0x94EBC8ABCFB56DAEULL,
+    0x9FC10D0F989993E0ULL, 0xDE68A2355B93CAE6ULL, 0xA44CFE79AE538BBEULL, 0x9D1D84FCCE371425ULL,
+    0x51D2B1AB2DDFB636ULL, 0x2FD7E4B9E72CD38CULL, 0x65CA5B96B7552210ULL, 0xDD69A0D8AB3B546DULL,
+    0x604D51B25FBF70E2ULL, 0x73AA8A564FB7AC9EULL, 0x1A8C1E992B941148ULL, 0xAAC40A2703D9BEA0ULL,
+    0x764DBEAE7FA4F3A6ULL, 0x1E99B96E70A9BE8BULL, 0x2C5E9DEB57EF4743ULL, 0x3A938FEE32D29981ULL,
+    0x26E6DB8FFDF5ADFEULL, 0x469356C504EC9F9DULL, 0xC8763C5B08D1908CULL, 0x3F6C6AF859D80055ULL,
+    0x7F7CC39420A3A545ULL, 0x9BFB227EBDF4C5CEULL, 0x89039D79D6FC5C5CULL, 0x8FE88B57305E2AB6ULL,
+    0xA09E8C8C35AB96DEULL, 0xFA7E393983325753ULL, 0xD6B6D0ECC617C699ULL, 0xDFEA21EA9E7557E3ULL,
+    0xB67C1FA481680AF8ULL, 0xCA1E3785A9E724E5ULL, 0x1CFC8BED0D681639ULL, 0xD18D8549D140CAEAULL,
+    0x4ED0FE7E9DC91335ULL, 0xE4DBF0634473F5D2ULL, 0x1761F93A44D5AEFEULL, 0x53898E4C3910DA55ULL,
+    0x734DE8181F6EC39AULL, 0x2680B122BAA28D97ULL, 0x298AF231C85BAFABULL, 0x7983EED3740847D5ULL,
+    0x66C1A2A1A60CD889ULL, 0x9E17E49642A3E4C1ULL, 0xEDB454E7BADC0805ULL, 0x50B704CAB602C329ULL,
+    0x4CC317FB9CDDD023ULL, 0x66B4835D9EAFEA22ULL, 0x219B97E26FFC81BDULL, 0x261E4E4C0A333A9DULL,
+    0x1FE2CCA76517DB90ULL, 0xD7504DFA8816EDBBULL, 0xB9571FA04DC089C8ULL, 0x1DDC0325259B27DEULL,
+    0xCF3F4688801EB9AAULL, 0xF4F5D05C10CAB243ULL, 0x38B6525C21A42B0EULL, 0x36F60E2BA4FA6800ULL,
+    0xEB3593803173E0CEULL, 0x9C4CD6257C5A3603ULL, 0xAF0C317D32ADAA8AULL, 0x258E5A80C7204C4BULL,
+    0x8B889D624D44885DULL, 0xF4D14597E660F855ULL, 0xD4347F66EC8941C3ULL, 0xE699ED85B0DFB40DULL,
+    0x2472F6207C2D0484ULL, 0xC2A1E7B5B459AEB5ULL, 0xAB4F6451CC1D45ECULL, 0x63767572AE3D6174ULL,
+    0xA59E0BD101731A28ULL, 0x116D0016CB948F09ULL, 0x2CF9C8CA052F6E9FULL, 0x0B090A7560A968E3ULL,
+    0xABEEDDB2DDE06FF1ULL, 0x58EFC10B06A2068DULL, 0xC6E57A78FBD986E0ULL, 0x2EAB8CA63CE802D7ULL,
+    0x14A195640116F336ULL, 0x7C0828DD624EC390ULL, 0xD74BBE77E6116AC7ULL, 0x804456AF10F5FB53ULL,
+    0xEBE9EA2ADF4321C7ULL, 0x03219A39EE587A30ULL, 0x49787FEF17AF9924ULL, 0xA1E9300CD8520548ULL,
+    0x5B45E522E4B1B4EFULL, 0xB49C3B3995091A36ULL, 0xD4490AD526F14431ULL, 0x12A8F216AF9418C2ULL,
+    0x001F837CC7350524ULL, 0x1877B51E57A764D5ULL, 0xA2853B80F17F58EEULL, 0x993E1DE72D36D310ULL,
+    0xB3598080CE64A656ULL, 0x252F59CF0D9F04BBULL, 0xD23C8E176D113600ULL, 0x1BDA0492E7E4586EULL,
+    0x21E0BD5026C619BFULL, 0x3B097ADAF088F94EULL, 0x8D14DEDB30BE846EULL, 0xF95CFFA23AF5F6F4ULL,
+    0x3871700761B3F743ULL, 0xCA672B91E9E4FA16ULL, 0x64C8E531BFF53B55ULL, 0x241260ED4AD1E87DULL,
+    0x106C09B972D2E822ULL, 0x7FBA195410E5CA30ULL, 0x7884D9BC6CB569D8ULL, 0x0647DFEDCD894A29ULL,
+    0x63573FF03E224774ULL, 0x4FC8E9560F91B123ULL, 0x1DB956E450275779ULL, 0xB8D91274B9E9D4FBULL,
+    0xA2EBEE47E2FBFCE1ULL, 0xD9F1F30CCD97FB09ULL, 0xEFED53D75FD64E6BULL, 0x2E6D02C36017F67FULL,
+    0xA9AA4D20DB084E9BULL, 0xB64BE8D8B25396C1ULL, 0x70CB6AF7C2D5BCF0ULL, 0x98F076A4F7A2322EULL,
+    0xBF84470805E69B5FULL, 0x94C3251F06F90CF3ULL, 0x3E003E616A6591E9ULL, 0xB925A6CD0421AFF3ULL,
+    0x61BDD1307C66E300ULL, 0xBF8D5108E27E0D48ULL, 0x240AB57A8B888B20ULL, 0xFC87614BAF287E07ULL,
+    0xEF02CDD06FFDB432ULL, 0xA1082C0466DF6C0AULL, 0x8215E577001332C8ULL, 0xD39BB9C3A48DB6CFULL,
+    0x2738259634305C14ULL, 0x61CF4F94C97DF93DULL, 0x1B6BACA2AE4E125BULL, 0x758F450C88572E0BULL,
+    0x959F587D507A8359ULL, 0xB063E962E045F54DULL, 0x60E8ED72C0DFF5D1ULL, 0x7B64978555326F9FULL,
+    0xFD080D236DA814BAULL, 0x8C90FD9B083F4558ULL, 0x106F72FE81E2C590ULL, 0x7976033A39F7D952ULL,
+    0xA4EC0132764CA04BULL, 0x733EA705FAE4FA77ULL, 0xB4D8F77BC3E56167ULL, 0x9E21F4F903B33FD9ULL,
+    0x9D765E419FB69F6DULL, 0xD30C088BA61EA5EFULL, 0x5D94337FBFAF7F5BULL, 0x1A4E4822EB4D7A59ULL,
+    0x6FFE73E81B637FB3ULL, 0xDDF957BC36D8B9CAULL, 0x64D0E29EEA8838B3ULL, 0x08DD9BDFD96B9F63ULL,
+    0x087E79E5A57D1D13ULL, 0xE328E230E3E2B3FBULL, 0x1C2559E30F0946BEULL, 0x720BF5F26F4D2EAAULL,
+    0xB0774D261CC609DBULL, 0x443F64EC5A371195ULL, 0x4112CF68649A260EULL, 0xD813F2FAB7F5C5CAULL,
+    0x660D3257380841EEULL, 0x59AC2C7873F910A3ULL, 0xE846963877671A17ULL, 0x93B633ABFA3469F8ULL,
+    0xC0C0F5A60EF4CDCFULL, 0xCAF21ECD4377B28CULL, 0x57277707199B8175ULL, 0x506C11B9D90E8B1DULL,
+    0xD83CC2687A19255FULL, 0x4A29C6465A314CD1ULL, 0xED2DF21216235097ULL, 0xB5635C95FF7296E2ULL,
+    0x22AF003AB672E811ULL, 0x52E762596BF68235ULL, 0x9AEBA33AC6ECC6B0ULL, 0x944F6DE09134DFB6ULL,
+    0x6C47BEC883A7DE39ULL, 0x6AD047C430A12104ULL, 0xA5B1CFDBA0AB4067ULL, 0x7C45D833AFF07862ULL,
+    0x5092EF950A16DA0BULL, 0x9338E69C052B8E7BULL, 0x455A4B4CFE30E3F5ULL, 0x6B02E63195AD0CF8ULL,
+    0x6B17B224BAD6BF27ULL, 0xD1E0CCD25BB9C169ULL, 0xDE0C89A556B9AE70ULL, 0x50065E535A213CF6ULL,
+    0x9C1169FA2777B874ULL, 0x78EDEFD694AF1EEDULL, 0x6DC93D9526A50E68ULL, 0xEE97F453F06791EDULL,
+    0x32AB0EDB696703D3ULL, 0x3A6853C7E70757A7ULL, 0x31865CED6120F37DULL, 0x67FEF95D92607890ULL,
+    0x1F2B1D1F15F6DC9CULL, 0xB69E38A8965C6B65ULL, 0xAA9119FF184CCCF4ULL, 0xF43C732873F24C13ULL,
+    0xFB4A3D794A9A80D2ULL, 0x3550C2321FD6109CULL, 0x371F77E76BB8417EULL, 0x6BFA9AAE5EC05779ULL,
+    0xCD04F3FF001A4778ULL, 0xE3273522064480CAULL, 0x9F91508BFFCFC14AULL, 0x049A7F41061A9E60ULL,
+    0xFCB6BE43A9F2FE9BULL, 0x08DE8A1C7797DA9BULL, 0x8F9887E6078735A1ULL, 0xB5B4071DBFC73A66ULL,
+    0x230E343DFBA08D33ULL, 0x43ED7F5A0FAE657DULL, 0x3A88A0FBBCB05C63ULL, 0x21874B8B4D2DBC4FULL,
+    0x1BDEA12E35F6A8C9ULL, 0x53C065C6C8E63528ULL, 0xE34A1D250E7A8D6BULL, 0xD6B04D3B7651DD7EULL,
+    0x5E90277E7CB39E2DULL, 0x2C046F22062DC67DULL, 0xB10BB459132D0A26ULL, 0x3FA9DDFB67E2F199ULL,
+    0x0E09B88E1914F7AFULL, 0x10E8B35AF3EEAB37ULL, 0x9EEDECA8E272B933ULL, 0xD4C718BC4AE8AE5FULL,
+    0x81536D601170FC20ULL, 0x91B534F885818A06ULL, 0xEC8177F83F900978ULL, 0x190E714FADA5156EULL,
+    0xB592BF39B0364963ULL, 0x89C350C893AE7DC1ULL, 0xAC042E70F8B383F2ULL, 0xB49B52E587A1EE60ULL,
+    0xFB152FE3FF26DA89ULL, 0x3E666E6F69AE2C15ULL, 0x3B544EBE544C19F9ULL, 0xE805A1E290CF2456ULL,
+    0x24B33C9D7ED25117ULL, 0xE74733427B72F0C1ULL, 0x0A804D18B7097475ULL, 0x57E3306D881EDB4FULL,
+    0x4AE7D6A36EB5DBCBULL, 0x2D8D5432157064C8ULL, 0xD1E649DE1E7F268BULL, 0x8A328A1CEDFE552CULL,
+    0x07A3AEC79624C7DAULL, 0x84547DDC3E203C94ULL, 0x990A98FD5071D263ULL, 0x1A4FF12616EEFC89ULL,
+    0xF6F7FD1431714200ULL, 0x30C05B1BA332F41CULL, 0x8D2636B81555A786ULL, 0x46C9FEB55D120902ULL,
+    0xCCEC0A73B49C9921ULL, 0x4E9D2827355FC492ULL, 0x19EBB029435DCB0FULL, 0x4659D2B743848A2CULL,
+    0x963EF2C96B33BE31ULL, 0x74F85198B05A2E7DULL, 0x5A0F544DD2B1FB18ULL, 0x03727073C2E134B1ULL,
+    0xC7F6AA2DE59AEA61ULL, 0x352787BAA0D7C22FULL, 0x9853EAB63B5E0B35ULL, 0xABBDCDD7ED5C0860ULL,
+    0xCF05DAF5AC8D77B0ULL, 0x49CAD48CEBF4A71EULL, 0x7A4C10EC2158C4A6ULL, 0xD9E92AA246BF719EULL,
+    0x13AE978D09FE5557ULL, 0x730499AF921549FFULL, 0x4E4B705B92903BA4ULL, 0xFF577222C14F0A3AULL,
+    0x55B6344CF97AAFAEULL, 0xB862225B055B6960ULL, 0xCAC09AFBDDD2CDB4ULL, 0xDAF8E9829FE96B5FULL,
+    0xB5FDFC5D3132C498ULL, 0x310CB380DB6F7503ULL, 0xE87FBB46217A360EULL, 0x2102AE466EBB1148ULL,
+    0xF8549E1A3AA5E00DULL, 0x07A69AFDCC42261AULL, 0xC4C118BFE78FEAAEULL, 0xF9F4892ED96BD438ULL,
+    0x1AF3DBE25D8F45DAULL, 0xF5B4B0B0D2DEEEB4ULL, 0x962ACEEFA82E1C84ULL, 0x046E3ECAAF453CE9ULL,
+    0xF05D129681949A4CULL, 0x964781CE734B3C84ULL, 0x9C2ED44081CE5FBDULL, 0x522E23F3925E319EULL,
+    0x177E00F9FC32F791ULL, 0x2BC60A63A6F3B3F2ULL, 0x222BBFAE61725606ULL, 0x486289DDCC3D6780ULL,
+    0x7DC7785B8EFDFC80ULL, 0x8AF38731C02BA980ULL, 0x1FAB64EA29A2DDF7ULL, 0xE4D9429322CD065AULL,
+    0x9DA058C67844F20CULL, 0x24C0E332B70019B0ULL, 0x233003B5A6CFE6ADULL, 0xD586BD01C5C217F6ULL,
+    0x5E5637885F29BC2BULL, 0x7EBA726D8C94094BULL, 0x0A56A5F0BFE39272ULL, 0xD79476A84EE20D06ULL,
+    0x9E4C1269BAA4BF37ULL, 0x17EFEE45B0DEE640ULL, 0x1D95B0A5FCF90BC6ULL, 0x93CBE0B699C2585DULL,
+    0x65FA4F227A2B6D79ULL, 0xD5F9E858292504D5ULL, 0xC2B5A03F71471A6FULL, 0x59300222B4561E00ULL,
+    0xCE2F8642CA0712DCULL, 0x7CA9723FBB2E8988ULL, 0x2785338347F2BA08ULL, 0xC61BB3A141E50E8CULL,
+    0x150F361DAB9DEC26ULL, 0x9F6A419D382595F4ULL, 0x64A53DC924FE7AC9ULL, 0x142DE49FFF7A7C3DULL,
+    0x0C335248857FA9E7ULL, 0x0A9C32D5EAE45305ULL, 0xE6C42178C4BBB92EULL, 0x71F1CE2490D20B07ULL,
+    0xF1BCC3D275AFE51AULL, 0xE728E8C83C334074ULL, 0x96FBF83A12884624ULL, 0x81A1549FD6573DA5ULL,
+    0x5FA7867CAF35E149ULL, 0x56986E2EF3ED091BULL, 0x917F1DD5F8886C61ULL, 0xD20D8C88C8FFE65FULL,
+    0x31D71DCE64B2C310ULL, 0xF165B587DF898190ULL, 0xA57E6339DD2CF3A0ULL, 0x1EF6E6DBB1961EC9ULL,
+    0x70CC73D90BC26E24ULL, 0xE21A6B35DF0C3AD7ULL, 0x003A93D8B2806962ULL, 0x1C99DED33CB890A1ULL,
+    0xCF3145DE0ADD4289ULL, 0xD0E4427A5514FB72ULL, 0x77C621CC9FB3A483ULL, 0x67A34DAC4356550BULL,
+    0xF8D626AAAF278509ULL
+};
+
+U64 polyglotKey(const Position *pos, char side) {
+    U64 k = 0; int rights = castleRights(pos);
+    for (int p=0;p<12;p++) for (U64 b=pos->pieceBB[p]; b; b&=b-1) k ^= POLYGLOT_RANDOM[64*(2*(p%6)+(p<6)) + (LSB(b)^56)];
+    for (int i=0;i<4;i++) if (rights>>i & 1) k ^= POLYGLOT_RANDOM[768+i];
+    if (epCapturable(pos)) k ^= POLYGLOT_RANDOM[772+pos->epC];
+    if (side=='w') k ^= POLYGLOT_RANDOM[780];
+    return k;
 }
 
-/* ===== Score simple ===== */
-int pieceScore(char p) {
-    switch(p){case 'P': return 1; case 'p': return -1; case 'N': return 3; case 'n': return -3; case 'B': return 3; case 'b': return -3; case 'R': return 5; case 'r': return -5; case 'Q': return 9; case 'q': return -9; default: return 0;}
+static inline U64 bookKey(const unsigned char *e) { U64 k = 0; for (int i=0;i<8;i++) k = k<<8 | e[i]; return k; }
+
+void bookClose(Book *b) { unmapFile(&b->file); b->data = NULL; b->entries = 0; }
+
+// map path read-only; returns 0 (and leaves b closed) when it cannot be mapped
+int bookOpen(Book *b, const char *path) {
+    bookClose(b);
+    if (!mapFile(&b->file, path)) return 0;
+    if (b->file.size<16) { unmapFile(&b->file); return 0; }
+    b->data = b->file.data; b->entries = b->file.size/16;
+    return 1;
 }
-int totalScore(){int s=0; for (int r=0;r<8;r++) for (int c=0;c<8;c++) s+=pieceScore(board[r][c]); return s;}
 
-/* ===== AI Semi-random: prefer captures else random ===== */
-void aiMove_SemiSmart() {
-    generateLegalMoves('b');
-    if (genCount==0) { printf("Komputer tidak punya langkah legal.\n"); gameOver=1; return; }
-    int captureIdx = -1; for (int i=0;i<genCount;i++) { if (board[genList[i].tr][genList[i].tc] != '.') { captureIdx = i; break; } }
-    int chosen = (captureIdx!=-1) ? captureIdx : (rand() % genCount);
-    Move m; m.fr = genList[chosen].fr; m.fc = genList[chosen].fc; m.tr = genList[chosen].tr; m.tc = genList[chosen].tc;
-    // apply as struct to keep clock etc.
-    makeMoveStruct(&m);
-    // auto-promotion to queen for AI
-    if (board[m.tr][m.tc]=='p' && m.tr==7) board[m.tr][m.tc]='q';
-    if (board[m.tr][m.tc]=='P' && m.tr==0) board[m.tr][m.tc]='Q';
-    lastFromR=m.fr; lastFromC=m.fc; lastToR=m.tr; lastToC=m.tc; recordHistory(m.fr,m.fc,m.tr,m.tc);
-    if (m.movedPiece>='a' && m.movedPiece<='z') fullmoveNumber++;
-    printf("Komputer: %c%d -> %c%d\n", 'a'+m.fc, 8-m.fr, 'a'+m.tc, 8-m.tr);
+// Polyglot move: to file 0-2, to row 3-5, from file 6-8, from row 9-11 (row 0 = rank 1),
+// promotion 12-14 (1 = knight .. 4 = queen); castling is written as king takes own rook
+unsigned short toBookMove(PackedMove pm) {
+    int from = PM_FROM(pm), to = PM_TO(pm);
+    if (PM_TYPE(pm)==MT_CASTLE) to = (to&~7) | (to%8==6 ? 7 : 0);
+    return (unsigned short)((to%8) | (7-to/8)<<3 | (from%8)<<6 | (7-from/8)<<9 | (PM_TYPE(pm)==MT_PROMO ? PM_PROMO(pm)+1 : 0)<<12);
 }
 
-/* ===== Endgame checks (checkmate/stalemate/50-move/insufficient) ===== */
-int inCheck(char side) {
-    char K = (side=='w')?'K':'k'; int kr=-1,kc=-1;
-    for (int r=0;r<8;r++) for (int c=0;c<8;c++) if (board[r][c]==K){kr=r;kc=c;}
-    if (kr==-1) return 0;
-    return isSquareAttacked(kr,kc, side=='w'?'b':'w');
+// a weighted random book move for the position, NO_MOVE when it is not in the book
+PackedMove bookProbe(const Book *b, const Position *pos, char side) {
+    if (!b->data) return NO_MOVE;
+    size_t lo = 0, hi = b->entries; U64 key = polyglotKey(pos, side);
+    while (lo<hi) { size_t mid = lo+(hi-lo)/2; if (bookKey(b->data+mid*16)<key) lo = mid+1; else hi = mid; }
+    MoveList ml; generateLegalMoves(pos, side, &ml);
+    PackedMove cand[64]; unsigned weight[64]; int n = 0; unsigned total = 0;
+    for (size_t i=lo; i<b->entries && n<64 && bookKey(b->data+i*16)==key; i++) {
+        const unsigned char *e = b->data+i*16;
+        unsigned short bm = (unsigned short)(e[8]<<8 | e[9]); unsigned w = e[10]<<8 | e[11];
+        // keep only entries that decode to a legal move here (guards against key collisions)
+        for (int k=0;k<ml.count;k++) if (toBookMove(ml.moves[k])==bm) { if (w) { cand[n] = ml.moves[k]; weight[n++] = w; total += w; } break; }
+    }
+    if (!n) return NO_MOVE;
+    unsigned r = (unsigned)(((unsigned long long)rand()*(RAND_MAX+1ULL) + rand()) % total);
+    for (int i=0;i<n;i++) { if (r<weight[i]) return cand[i]; r -= weight[i]; }
+    return cand[n-1];
 }
 
-int hasAnyLegalMove(char side){ generateLegalMoves(side); return genCount>0; }
+/* ===== Computer player ===== */
+SearchLimits engineLimits = {1000, 0, 0, 1, 1}; // 1 s per move; threads set from cpuCount() in main
+int ponderEnabled = 1;
 
-int insufficientMaterial(){
-    int wP=0,wN=0,wB=0,wR=0,wQ=0; int bP=0,bN=0,bB=0,bR=0,bQ=0;
-    for (int r=0;r<8;r++) for (int c=0;c<8;c++){ char p=board[r][c];
-        switch(p){ case 'P': wP++; break; case 'N': wN++; break; case 'B': wB++; break; case 'R': wR++; break; case 'Q': wQ++; break;
-                   case 'p': bP++; break; case 'n': bN++; break; case 'b': bB++; break; case 'r': bR++; break; case 'q': bQ++; break; }
-    }
-    if (wP+bP+wR+bR+wQ+bQ==0) {
-        if (wN+wB==0 && bN+bB==0) return 1;
-        if ((wN+wB==1) && (bN+bB==0)) return 1;
-        if ((bN+bB==1) && (wN+wB==0)) return 1;
-    }
-    return 0;
+/* Pondering: while the human thinks, a background thread searches the position
+   after the reply the engine expects (the TT move of the position it left).
+   When the human plays that move (ponder hit) the search simply goes on, now
+   bound by the normal limits counted from when pondering began, so a long
+   human think gets an instant answer. Any other move aborts it (ponder miss). */
+typedef struct {
+    pthread_t tid; int active;
+    Position pos; char side;          // position after the expected reply, engine to move
+    PackedMove move;                  // the expected reply
+    U64 keys[MAX_HISTORY+1]; int nkeys;
+    SearchLimits limits;
+    PackedMove best; int found;
+} Ponder;
+Ponder ponder;
+
+void *ponderWorker(void *arg) {
+    (void)arg;
+    ponder.found = searchBestMove(&mainSearch, &ponder.pos, ponder.side, ponder.keys, ponder.nkeys, &ponder.limits, &ponder.best, NULL);
+    return NULL;
 }
 
-void checkGameEndConditionsAndReport(char playerTurn, char mode, char playerColor) {
-    // check kings existence
-    int foundW=0, foundB=0;
-    for (int r=0;r<8;r++) for (int c=0;c<8;c++){ if (board[r][c]=='K') foundW=1; if (board[r][c]=='k') foundB=1;}
-    if (!foundW){ printf("\n=== Raja putih hilang! HITAM MENANG! ===\n"); gameOver=1; return; }
-    if (!foundB){ printf("\n=== Raja hitam hilang! PUTIH MENANG! ===\n"); gameOver=1; return; }
-    if (halfmoveClock>=100){ printf("\n=== Draw by 50-move rule ===\n"); gameOver=1; return; }
-    if (insufficientMaterial()){ printf("\n=== Draw by insufficient material ===\n"); gameOver=1; return; }
-    // check stalemate / checkmate for side to move (playerTurn tells previous mover in some calls)
-    if (!hasAnyLegalMove(playerTurn)) {
-        if (inCheck(playerTurn)) {
-            // checkmate: other side won
-            if (playerTurn=='w') {
-                printf("\n=== CHECKMATE! HITAM MENANG! ===\n");
-                if (mode=='C') {
-                    // if playerColor == 'b' and black won when player is black
-                    if (playerColor=='b') printf("Kamu menang!\n"); else printf("Kamu kalah!\n");
-                }
-            } else {
-                printf("\n=== CHECKMATE! PUTIH MENANG! ===\n");
-                if (mode=='C') {
-                    if (playerColor=='w') printf("Kamu menang!\n"); else printf("Kamu kalah!\n");
-                }
-            }
-            gameOver=1; return;
-        } else {
-            printf("\n=== STALEMATE! DRAW ===\n"); gameOver=1; return;
-        }
-    }
+// start pondering for engineSide, which has just moved in g
+void startPonder(const Game *g, char engineSide) {
+    TTHit hit; int n = g->historyCount+1;
+    if (!ponderEnabled || ponder.active || g->gameOver || n>=MAX_HISTORY) return;
+    if (!ttProbe(&mainTT, g->pos.key, &hit) || !isMoveLegal(&g->pos, OPP(engineSide), hit.move)) return;
+    Move m; ponder.move = hit.move; ponder.pos = g->pos; playMove(&ponder.pos, hit.move, &m);
+    memcpy(ponder.keys, g->keys, n*sizeof(U64)); ponder.keys[n] = ponder.pos.key; ponder.nkeys = n+1;
+    ponder.side = engineSide; ponder.limits = engineLimits; ponder.limits.verbose = 0; // no output while the human types
+    atomic_store(&mainSearch.pondering, 1);
+    pthread_attr_t attr; pthread_attr_init(&attr); pthread_attr_setstacksize(&attr, 8u<<20);
+    ponder.active = pthread_create(&ponder.tid, &attr, ponderWorker, NULL)==0;
+    pthread_attr_destroy(&attr);
+    if (!ponder.active) atomic_store(&mainSearch.pondering, 0);
+}
+
+// end pondering; returns 1 with the engine's move when g (NULL: abandon) is at the pondered position
+int finishPonder(const Game *g, PackedMove *pm) {
+    if (!ponder.active) return 0;
+    int hit = g && g->pos.key==ponder.pos.key && sideToMove(g)==ponder.side;
+    if (hit) atomic_store(&mainSearch.pondering, 0); // from now on the limits apply
+    else atomic_store(&searchAbort, 1);
+    pthread_join(ponder.tid, NULL); ponder.active = 0;
+    atomic_store(&mainSearch.pondering, 0); atomic_store(&searchAbort, 0);
+    if (!hit || !ponder.found) return 0;
+    *pm = ponder.best;
+    return 1;
+}
+
+void stopPonder(void) { PackedMove pm; finishPonder(NULL, &pm); }
+
+// search and play the computer's move for side (book move first); returns 0 when it has no
+// legal move or the game record is full
+int computerMove(Game *g, char side) {
+    long long t0 = nowMs(); PackedMove pm;
+    if (finishPonder(g, &pm)) { printf("(ponder hit: langkahmu sudah diperkirakan)\n"); statMoveTime(nowMs()-t0); return commitMove(g, pm); }
+    if (g->historyCount>=MAX_HISTORY) return 0;
+    pm = bookProbe(&openingBook, &g->pos, side);
+    if (pm) { statMoveTime(nowMs()-t0); return commitMove(g, pm); }
+    if (!searchBestMove(&mainSearch, &g->pos, side, g->keys, g->historyCount+1, &engineLimits, &pm, NULL)) return 0;
+    statMoveTime(nowMs()-t0);
+    return commitMove(g, pm);
 }
 
 /* ===== Input parsing (accept many formats) ===== */
@@ -503,8 +2693,9 @@ int parseSquare(const char *s, int *r, int *c) {
     *c = colIndex(file); *r = 8 - (rank - '0'); return 1;
 }
 
-// read move pair; supports "e2 e4", "e2e4", "O-O", "O-O-O", "exit"
-int readMovePair(char *outA, size_t lena, char *outB, size_t lenb) {
+// read move pair; supports "e2 e4", "e2e4", "O-O", "O-O-O", "undo", "exit",
+// "fen" and "fen <FEN>" (the FEN text goes to arg)
+int readMovePair(char *outA, size_t lena, char *outB, size_t lenb, char *arg, size_t lenarg) {
     char line[256];
     if (!fgets(line, sizeof(line), stdin)) return 0;
     // trim newline
@@ -514,6 +2705,18 @@ int readMovePair(char *outA, size_t lena, char *outB, size_t lenb) {
     char *s = line;
     while (*s && isspace((unsigned char)*s)) s++;
     if (!*s) return 0;
+    // fen command: keep the rest of the line verbatim, '-' is meaningful there
+    if (strncasecmp(s,"fen",3)==0 && (s[3]=='\0' || isspace((unsigned char)s[3]))) {
+        s += 3; while (*s && isspace((unsigned char)*s)) s++;
+        strncpy(outA,"fen",lena-1); outA[lena-1]='\0'; outB[0]='\0';
+        strncpy(arg,s,lenarg-1); arg[lenarg-1]='\0'; return 1;
+    }
+    // castling before normalizing, which would split "O-O" at its dashes
+    char tmp[16]; int ti=0;
+    for (int i=0; s[i] && !isspace((unsigned char)s[i]) && i<15; ++i) tmp[ti++]=toupper((unsigned char)s[i]);
+    tmp[ti]='\0';
+    if (strcmp(tmp,"O-O")==0 || strcmp(tmp,"0-0")==0) { strncpy(outA,"O-O",lena-1); outA[lena-1]='\0'; outB[0]='\0'; return 1; }
+    if (strcmp(tmp,"O-O-O")==0 || strcmp(tmp,"0-0-0")==0) { strncpy(outA,"O-O-O",lena-1); outA[lena-1]='\0'; outB[0]='\0'; return 1; }
     // normalize
     for (char *p=s; *p; ++p) if (*p=='-' || *p==',') *p=' ';
     // tokenize
@@ -522,11 +2725,8 @@ int readMovePair(char *outA, size_t lena, char *outB, size_t lenb) {
     if (!tok1) return 0;
     // exit
     if (strcasecmp(tok1,"exit")==0) { strncpy(outA,"exit",lena-1); outA[lena-1]='\0'; outB[0]='\0'; return 1;}
-    // handle O-O
-    char tmp[16]; int ti=0;
-    for (int i=0; tok1[i] && i<15; ++i) tmp[ti++]=toupper((unsigned char)tok1[i]); tmp[ti]='\0';
-    if (strcmp(tmp,"O-O")==0 || strcmp(tmp,"0-0")==0) { strncpy(outA,"O-O",lena-1); outA[lena-1]='\0'; outB[0]='\0'; return 1; }
-    if (strcmp(tmp,"O-O-O")==0 || strcmp(tmp,"0-0-0")==0) { strncpy(outA,"O-O-O",lena-1); outA[lena-1]='\0'; outB[0]='\0'; return 1; }
+    if (strcasecmp(tok1,"undo")==0) { strncpy(outA,"undo",lena-1); outA[lena-1]='\0'; outB[0]='\0'; return 1;}
+    if (strcasecmp(tok1,"stats")==0) { strncpy(outA,"stats",lena-1); outA[lena-1]='\0'; outB[0]='\0'; return 1;}
     if (tok2==NULL && strlen(tok1)==4) {
         outA[0]=tolower((unsigned char)tok1[0]); outA[1]=tok1[1]; outA[2]='\0';
         outB[0]=tolower((unsigned char)tok1[2]); outB[1]=tok1[3]; outB[2]='\0';
@@ -539,175 +2739,1103 @@ int readMovePair(char *outA, size_t lena, char *outB, size_t lenb) {
 }
 
 /* ===== Game loops (User vs User and User vs Computer) ===== */
-void userVsUserLoop() {
+// in-game "fen": print the current position, or "fen <FEN>" to set up a new one.
+// Returns 1 when a new position was loaded (the move record restarts from it)
+int fenCommand(Game *g, const char *arg) {
+    if (!*arg) { char fen[FEN_MAX]; toFen(&g->pos, sideToMove(g), fen); printf("FEN: %s\n", fen); return 0; }
+    if (!initGameFromFen(g, arg)) { printf("FEN tidak valid!\n"); return 0; }
+    printf("Posisi dimuat, giliran %s.\n", sideToMove(g)=='w' ? "Putih" : "Hitam");
+    return 1;
+}
+
+void userVsUserLoop(Game *g) {
+    Position *pos = &g->pos;
     int turn = 1; // 1 = white to move, -1 = black to move
-    char a[16], b[16];
-    while (!gameOver) {
-        printBoard();
+    char a[16], b[16], arg[128];
+    statNewGame();
+    while (!g->gameOver) {
+        printBoard(g);
         printf("\nGiliran %s\n", turn==1 ? "Putih" : "Hitam");
-        printf("Masukkan langkah (contoh a2 a3 atau e2e4 atau O-O), atau 'exit': ");
-        if (!readMovePair(a,sizeof(a),b,sizeof(b))) { printf("Input tidak terbaca atau EOF. Kembali ke menu.\n"); break; }
+        printf("Masukkan langkah (contoh a2 a3 atau e2e4 atau O-O), 'undo', 'fen', 'stats', atau 'exit': ");
+        if (!readMovePair(a,sizeof(a),b,sizeof(b),arg,sizeof(arg))) { printf("Input tidak terbaca atau EOF. Kembali ke menu.\n"); break; }
         if (strcmp(a,"exit")==0) { printf("Keluar dari permainan.\n"); break; }
+        if (strcmp(a,"stats")==0) { printStats(stdout); continue; }
+        if (strcmp(a,"fen")==0) {
+            if (fenCommand(g, arg)) { turn = sideToMove(g)=='w' ? 1 : -1; checkGameEndConditionsAndReport(g, sideToMove(g), 'P', 'w'); }
+            continue;
+        }
+        // takeback one ply
+        if (strcmp(a,"undo")==0) {
+            if (!takebackMove(g)) { printf("Belum ada langkah untuk dibatalkan.\n"); continue; }
+            printf("Langkah terakhir dibatalkan.\n");
+            turn *= -1; continue;
+        }
         // handle O-O
         if (strcmp(a,"O-O")==0 || strcmp(a,"O-O-O")==0) {
             int fr = (turn==1) ? 7 : 0;
             int fc = 4;
             int tr = fr;
             int tc = (strcmp(a,"O-O")==0) ? 6 : 2;
-            // validate via generator
-            generateLegalMoves(turn==1 ? 'w' : 'b');
-            int legal=0; for (int i=0;i<genCount;i++) if (genList[i].fr==fr && genList[i].fc==fc && genList[i].tr==tr && genList[i].tc==tc) { legal=1; break; }
-            if (!legal) { printf("Castling tidak sah!\n"); continue; }
-            Move m = {fr,fc,tr,tc,0,0,0}; makeMoveStruct(&m);
-            // no promotion for castling
-            lastFromR=fr; lastFromC=fc; lastToR=tr; lastToC=tc; recordHistory(fr,fc,tr,tc);
-            if (m.movedPiece>='a' && m.movedPiece<='z') fullmoveNumber++;
-            checkGameEndConditionsAndReport(turn==1 ? 'b' : 'w', 'P', 'w');
+            PackedMove pm = PACK_MOVE(SQ(fr,fc),SQ(tr,tc),MT_CASTLE,0);
+            if (!isMoveLegal(pos, turn==1 ? 'w' : 'b', pm)) { printf("Castling tidak sah!\n"); continue; }
+            commitMove(g, pm);
+            checkGameEndConditionsAndReport(g, turn==1 ? 'b' : 'w', 'P', 'w');
             turn *= -1; continue;
         }
         int fr,fc,tr,tc;
         if (!parseSquare(a,&fr,&fc) || !parseSquare(b,&tr,&tc)) { printf("Format salah!\n"); continue; }
         if (!validPos(fr,fc) || !validPos(tr,tc)) { printf("Posisi tidak valid!\n"); continue; }
-        char piece = board[fr][fc];
+        char piece = pos->board[fr][fc];
         if (turn==1 && !(piece>='A'&&piece<='Z')){ printf("Itu bukan bidak putih!\n"); continue;}
         if (turn==-1 && !(piece>='a'&&piece<='z')){ printf("Itu bukan bidak hitam!\n"); continue; }
-        // generate moves and check legality
-        generateLegalMoves(turn==1 ? 'w' : 'b');
-        int legal=0; for (int i=0;i<genCount;i++) if (genList[i].fr==fr && genList[i].fc==fc && genList[i].tr==tr && genList[i].tc==tc) { legal=1; break; }
-        if (!legal){ printf("Langkah tidak sah!\n"); continue; }
-        Move m = {fr,fc,tr,tc,0,0,0}; makeMoveStruct(&m);
-        // promotion interactive: if pawn reached last rank, ask choice (we already moved, so piece is there)
-        if ((board[tr][tc]=='P' && tr==0) || (board[tr][tc]=='p' && tr==7)) {
-            int isWhite = (board[tr][tc]=='P');
-            char prom = askPromotionPiece(isWhite);
-            board[tr][tc] = isWhite ? prom : tolower(prom);
-        }
-        lastFromR=fr; lastFromC=fc; lastToR=tr; lastToC=tc; recordHistory(fr,fc,tr,tc);
-        if (m.movedPiece>='a' && m.movedPiece<='z') fullmoveNumber++;
-        checkGameEndConditionsAndReport(turn==1 ? 'b' : 'w', 'P', 'w');
+        // check just this move for legality
+        PackedMove pm = inputMove(pos,fr,fc,tr,tc);
+        if (!isMoveLegal(pos, turn==1 ? 'w' : 'b', pm)){ printf("Langkah tidak sah!\n"); continue; }
+        // promotion interactive: ask before moving so the record carries the choice
+        if (PM_TYPE(pm)==MT_PROMO) pm = withPromotion(pm, askPromotionPiece(1));
+        commitMove(g, pm);
+        checkGameEndConditionsAndReport(g, turn==1 ? 'b' : 'w', 'P', 'w');
         turn *= -1;
     }
 }
 
-void userVsComputerLoop(char playerColor) {
+void userVsComputerLoop(Game *g, char playerColor) {
+    Position *pos = &g->pos;
     // playerColor == 'w' means human plays white; if 'b' human plays black
     char human = playerColor; char computer = (playerColor=='w')?'b':'w';
     int turn = 1; // 1 -> white to move; -1 -> black to move
+    statNewGame();
     // If human is black, computer moves first (white first)
     if (turn==1 && computer=='w') {
         // computer first move
-        generateLegalMoves('w'); if (genCount>0) { Move m; m.fr=genList[0].fr; m.fc=genList[0].fc; m.tr=genList[0].tr; m.tc=genList[0].tc; makeMoveStruct(&m);
-            if (board[m.tr][m.tc]=='p' && m.tr==7) board[m.tr][m.tc]='q';
-            if (board[m.tr][m.tc]=='P' && m.tr==0) board[m.tr][m.tc]='Q';
-            lastFromR=m.fr; lastFromC=m.fc; lastToR=m.tr; lastToC=m.tc; recordHistory(m.fr,m.fc,m.tr,m.tc);
-            printf("Komputer (putih) membuka: %c%d -> %c%d\n", 'a'+m.fc, 8-m.fr, 'a'+m.tc, 8-m.tr);
-            if (m.movedPiece>='a' && m.movedPiece<='z') fullmoveNumber++;
-        }
+        if (computerMove(g, 'w')) printf("Komputer (putih) membuka: %c%d -> %c%d\n", 'a'+g->lastFromC, 8-g->lastFromR, 'a'+g->lastToC, 8-g->lastToR);
         turn = -1;
     }
-    while (!gameOver) {
-        printBoard();
+    while (!g->gameOver) {
+        printBoard(g);
         printf("\nGiliran %s\n", turn==1 ? "Putih" : "Hitam");
         if ((turn==1 && human=='w') || (turn==-1 && human=='b')) {
-            // human move
-            char a[16], b[16]; printf("Masukkan langkah (contoh a2 a3 atau e2e4 atau O-O), atau 'exit': ");
-            if (!readMovePair(a,sizeof(a),b,sizeof(b))) { printf("Input tidak terbaca atau EOF. Kembali ke menu.\n"); break; }
+            // human move; the engine ponders meanwhile
+            startPonder(g, computer);
+            char a[16], b[16], arg[128]; printf("Masukkan langkah (contoh a2 a3 atau e2e4 atau O-O), 'undo', 'fen', 'stats', atau 'exit': ");
+            if (!readMovePair(a,sizeof(a),b,sizeof(b),arg,sizeof(arg))) { printf("Input tidak terbaca atau EOF. Kembali ke menu.\n"); break; }
             if (strcmp(a,"exit")==0) { printf("Keluar dari permainan.\n"); break; }
+            if (strcmp(a,"stats")==0) { printStats(stdout); continue; }
+            if (strcmp(a,"fen")==0) {
+                if (*arg) stopPonder();
+                if (fenCommand(g, arg)) { turn = sideToMove(g)=='w' ? 1 : -1; checkGameEndConditionsAndReport(g, sideToMove(g), 'C', human); }
+                continue;
+            }
+            // takeback: undo the computer's reply and our own last move, same side stays to move
+            if (strcmp(a,"undo")==0) {
+                if (g->historyCount<2) { printf("Belum ada langkah untuk dibatalkan.\n"); continue; }
+                stopPonder(); takebackMove(g); takebackMove(g);
+                printf("Dua langkah terakhir dibatalkan.\n");
+                continue;
+            }
             // handle O-O
             if (strcmp(a,"O-O")==0 || strcmp(a,"O-O-O")==0) {
                 int fr = (turn==1) ? 7 : 0;
                 int fc = 4;
                 int tr = fr;
                 int tc = (strcmp(a,"O-O")==0) ? 6 : 2;
-                generateLegalMoves(turn==1 ? 'w' : 'b');
-                int legal=0; for (int i=0;i<genCount;i++) if (genList[i].fr==fr && genList[i].fc==fc && genList[i].tr==tr && genList[i].tc==tc) { legal=1; break; }
-                if (!legal) { printf("Castling tidak sah!\n"); continue; }
-                Move mm = {fr,fc,tr,tc,0,0,0}; makeMoveStruct(&mm);
-                lastFromR=fr; lastFromC=fc; lastToR=tr; lastToC=tc; recordHistory(fr,fc,tr,tc);
-                if (mm.movedPiece>='a' && mm.movedPiece<='z') fullmoveNumber++;
+                PackedMove pm = PACK_MOVE(SQ(fr,fc),SQ(tr,tc),MT_CASTLE,0);
+                if (!isMoveLegal(pos, turn==1 ? 'w' : 'b', pm)) { printf("Castling tidak sah!\n"); continue; }
+                commitMove(g, pm);
                 // check end conditions for opponent
-                checkGameEndConditionsAndReport(turn==1 ? 'b' : 'w', 'C', human);
+                checkGameEndConditionsAndReport(g, turn==1 ? 'b' : 'w', 'C', human);
                 turn = -turn;
                 continue;
             }
             int fr,fc,tr,tc;
             if (!parseSquare(a,&fr,&fc) || !parseSquare(b,&tr,&tc)) { printf("Format salah!\n"); continue; }
             if (!validPos(fr,fc) || !validPos(tr,tc)) { printf("Posisi tidak valid!\n"); continue; }
-            char piece = board[fr][fc];
+            char piece = pos->board[fr][fc];
             if (turn==1 && !(piece>='A'&&piece<='Z')){ printf("Itu bukan bidak putih!\n"); continue;}
             if (turn==-1 && !(piece>='a'&&piece<='z')){ printf("Itu bukan bidak hitam!\n"); continue; }
-            generateLegalMoves(turn==1 ? 'w' : 'b');
-            int legal=0; for (int i=0;i<genCount;i++) if (genList[i].fr==fr && genList[i].fc==fc && genList[i].tr==tr && genList[i].tc==tc) { legal=1; break; }
-            if (!legal){ printf("Langkah tidak sah!\n"); continue; }
-            Move m = {fr,fc,tr,tc,0,0,0}; makeMoveStruct(&m);
-            // promotion for human: ask choice if reached last rank
-            if ((board[tr][tc]=='P' && tr==0) || (board[tr][tc]=='p' && tr==7)) {
-                int isWhite = (board[tr][tc]=='P');
-                char prom = askPromotionPiece(isWhite);
-                board[tr][tc] = isWhite ? prom : tolower(prom);
-            }
-            lastFromR=fr; lastFromC=fc; lastToR=tr; lastToC=tc; recordHistory(fr,fc,tr,tc);
-            if (m.movedPiece>='a' && m.movedPiece<='z') fullmoveNumber++;
+            PackedMove pm = inputMove(pos,fr,fc,tr,tc);
+            if (!isMoveLegal(pos, turn==1 ? 'w' : 'b', pm)){ printf("Langkah tidak sah!\n"); continue; }
+            // promotion for human: ask choice before moving if reaching last rank
+            if (PM_TYPE(pm)==MT_PROMO) pm = withPromotion(pm, askPromotionPiece(1));
+            commitMove(g, pm);
             // check end conditions
-            checkGameEndConditionsAndReport(turn==1 ? 'b' : 'w', 'C', human);
+            checkGameEndConditionsAndReport(g, turn==1 ? 'b' : 'w', 'C', human);
             turn = -turn;
         } else {
             // computer move
             printf("Giliran komputer (%s)\n", (turn==1)?"Putih":"Hitam");
-            if (turn==1) { generateLegalMoves('w'); }
-            else { generateLegalMoves('b'); }
-            if (genCount==0) { // no moves -> check end
-                checkGameEndConditionsAndReport(turn, 'C', human);
+            if (!computerMove(g, computer)) { // no moves -> check end
+                checkGameEndConditionsAndReport(g, computer, 'C', human);
                 break;
             }
-            // choose capture if possible
-            int captureIdx=-1;
-            for (int i=0;i<genCount;i++) if (board[genList[i].tr][genList[i].tc] != '.') { captureIdx=i; break; }
-            int chosen = (captureIdx!=-1)?captureIdx:(rand()%genCount);
-            Move m; m.fr=genList[chosen].fr; m.fc=genList[chosen].fc; m.tr=genList[chosen].tr; m.tc=genList[chosen].tc;
-            makeMoveStruct(&m);
-            // auto promote AI pawns to queen
-            if (board[m.tr][m.tc]=='p' && m.tr==7) board[m.tr][m.tc]='q';
-            if (board[m.tr][m.tc]=='P' && m.tr==0) board[m.tr][m.tc]='Q';
-            lastFromR=m.fr; lastFromC=m.fc; lastToR=m.tr; lastToC=m.tc; recordHistory(m.fr,m.fc,m.tr,m.tc);
-            if (m.movedPiece>='a' && m.movedPiece<='z') fullmoveNumber++;
-            printf("Komputer: %c%d -> %c%d\n", 'a'+m.fc, 8-m.fr, 'a'+m.tc, 8-m.tr);
+            printf("Komputer: %c%d -> %c%d\n", 'a'+g->lastFromC, 8-g->lastFromR, 'a'+g->lastToC, 8-g->lastToR);
             // check end conditions
-            checkGameEndConditionsAndReport(turn==1 ? 'b' : 'w', 'C', human);
+            checkGameEndConditionsAndReport(g, turn==1 ? 'b' : 'w', 'C', human);
             turn = -turn;
         }
     }
+    stopPonder();
+}
+
+/* ===== UCI mode (--uci) =====
+   Headless protocol loop for GUIs, tournament managers and batch drivers: no
+   prompts and no board printing. "go" runs the search on its own thread, so
+   "stop", "isready" and "quit" are answered while it thinks. */
+Game uciGame;
+SearchLimits uciLimits;
+pthread_t uciSearchTid; int uciSearching = 0;
+int uciInfinite = 0;         // "go infinite": bestmove only after "stop"
+
+// a coordinate move ("e2e4", "e7e8q") if it is legal for side, else NO_MOVE
+PackedMove parseCoordMove(const Position *pos, char side, const char *s) {
+    int fr,fc,tr,tc;
+    if (strlen(s)<4 || !parseSquare(s,&fr,&fc) || !parseSquare(s+2,&tr,&tc)) return NO_MOVE;
+    PackedMove pm = inputMove(pos,fr,fc,tr,tc);
+    if (PM_TYPE(pm)==MT_PROMO && s[4]) pm = withPromotion(pm, s[4]);
+    return isMoveLegal(pos, side, pm) ? pm : NO_MOVE;
+}
+
+void *uciSearchWorker(void *arg) {
+    Game *g = (Game*)arg; PackedMove best; char mv[8] = "0000"; long long t0 = nowMs();
+    if (searchBestMove(&mainSearch, &g->pos, sideToMove(g), g->keys, g->historyCount+1, &uciLimits, &best, NULL)) moveToStr(best, mv);
+    statMoveTime(nowMs()-t0);
+    while (uciInfinite && !atomic_load(&searchAbort)) sleepMs(1);
+    printf("bestmove %s\n", mv); fflush(stdout);
+    return NULL;
+}
+
+void uciWaitSearch() { if (uciSearching) { pthread_join(uciSearchTid, NULL); uciSearching = 0; } }
+
+// position [startpos | fen <fen>] [moves <m1> <m2> ...]
+void uciPosition(char *args) {
+    char *movesPart = strstr(args, "moves");
+    if (movesPart) { movesPart[-1] = '\0'; movesPart += 5; }
+    if (strncmp(args, "fen", 3)==0) { args += 3; while (isspace((unsigned char)*args)) args++;
+        if (!initGameFromFen(&uciGame, args)) { printf("info string FEN tidak valid\n"); return; }
+    }
+    else initBoard(&uciGame);
+    if (!movesPart) return;
+    for (char *tok = strtok(movesPart, " \t"); tok; tok = strtok(NULL, " \t")) {
+        PackedMove pm = parseCoordMove(&uciGame.pos, sideToMove(&uciGame), tok);
+        if (pm==NO_MOVE || uciGame.historyCount>=MAX_HISTORY) { printf("info string langkah ilegal: %s\n", tok); return; }
+        commitMove(&uciGame, pm);
+    }
+}
+
+// go [depth n] [nodes n] [movetime ms] [wtime ms btime ms winc ms binc ms movestogo n] [infinite]
+void uciGo(char *args) {
+    long long wtime=-1, btime=-1, winc=0, binc=0, movestogo=0, movetime=0, depth=0, nodes=0; int infinite = 0;
+    for (char *tok = strtok(args, " \t"); tok; tok = strtok(NULL, " \t")) {
+        long long *dst = NULL;
+        if (!strcmp(tok,"infinite")) { infinite = 1; continue; }
+        if (!strcmp(tok,"wtime")) dst=&wtime; else if (!strcmp(tok,"btime")) dst=&btime;
+        else if (!strcmp(tok,"winc")) dst=&winc; else if (!strcmp(tok,"binc")) dst=&binc;
+        else if (!strcmp(tok,"movestogo")) dst=&movestogo; else if (!strcmp(tok,"movetime")) dst=&movetime;
+        else if (!strcmp(tok,"depth")) dst=&depth; else if (!strcmp(tok,"nodes")) dst=&nodes;
+        char *val = dst ? strtok(NULL, " \t") : NULL;
+        if (val) *dst = atoll(val);
+    }
+    uciLimits.maxDepth = (int)depth; uciLimits.nodeLimit = nodes; uciLimits.moveTimeMs = (int)movetime; uciLimits.verbose = 1;
+    long long left = sideToMove(&uciGame)=='w' ? wtime : btime, inc = sideToMove(&uciGame)=='w' ? winc : binc;
+    if (!movetime && left>=0) {
+        // share the clock over the remaining moves, keep a safety margin for move overhead
+        long long budget = left/(movestogo>0 ? movestogo : 30) + inc*3/4;
+        if (budget > left-50) budget = left-50;
+        uciLimits.moveTimeMs = (int)(budget>10 ? budget : 10);
+    }
+    uciInfinite = infinite;
+    // a book move is answered at once, without a search
+    PackedMove bm = infinite ? NO_MOVE : bookProbe(&openingBook, &uciGame.pos, sideToMove(&uciGame));
+    if (bm) { char mv[8]; moveToStr(bm, mv); printf("info string buku\nbestmove %s\n", mv); fflush(stdout); return; }
+    atomic_store(&searchAbort, 0);
+    if (pthread_create(&uciSearchTid, NULL, uciSearchWorker, &uciGame)==0) uciSearching = 1;
+}
+
+int uciLoop() {
+    static char line[65536]; // "position ... moves" lines grow with the game
+    uciLimits.threads = 1;
+    initBoard(&uciGame);
+    while (fgets(line, sizeof(line), stdin)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        char *cmd = line; while (isspace((unsigned char)*cmd)) cmd++;
+        char *args = cmd + strcspn(cmd, " \t"); if (*args) *args++ = '\0';
+        while (isspace((unsigned char)*args)) args++;
+        if (!strcmp(cmd,"uci")) {
+            printf("id name Catur\nid author Kelompok 2 DASPRO\n");
+            printf("option name Hash type spin default %d min 1 max 65536\n", TT_DEFAULT_MB);
+            printf("option name Threads type spin default 1 min 1 max %d\n", MAX_THREADS);
+            printf("option name BookFile type string default <empty>\n");
+            printf("uciok\n");
+        } else if (!strcmp(cmd,"isready")) printf("readyok\n");
+        else if (!strcmp(cmd,"ucinewgame")) { uciWaitSearch(); ttClear(&mainTT); initBoard(&uciGame); statNewGame(); }
+        else if (!strcmp(cmd,"setoption")) {
+            // setoption name <Hash|Threads> value <n>
+            char name[32] = ""; long long v = 0; char path[1024];
+            if (sscanf(args, "name BookFile value %1023[^\n]", path)==1) {
+                uciWaitSearch();
+                if (!strcmp(path,"<empty>")) bookClose(&openingBook);
+                else if (!bookOpen(&openingBook, path)) printf("info string buku %s tidak bisa dibuka\n", path);
+            }
+            else if (sscanf(args, "name %31s value %lld", name, &v)==2) {
+                uciWaitSearch();
+                if (!strcasecmp(name,"Hash")) { if (ttResize(&mainTT, (size_t)v)) ttSizeMb = v; else printf("info string Hash %lld MB gagal dialokasikan\n", v); }
+                else if (!strcasecmp(name,"Threads")) uciLimits.threads = v<1 ? 1 : v>MAX_THREADS ? MAX_THREADS : (int)v;
+            }
+        }
+        else if (!strcmp(cmd,"position")) { uciWaitSearch(); uciPosition(args); }
+        else if (!strcmp(cmd,"go")) { uciWaitSearch(); uciGo(args); }
+        else if (!strcmp(cmd,"stop")) { atomic_store(&searchAbort, 1); uciWaitSearch(); }
+        else if (!strcmp(cmd,"quit")) break;
+        fflush(stdout);
+    }
+    atomic_store(&searchAbort, 1); uciWaitSearch();
+    return 0;
+}
+
+/* ===== Self-play tournament (--selfplay) =====
+   Engine A against engine B (the same code, each with its own limits) over a set
+   of openings, every opening played once with each color. Games run concurrently
+   on a pool of workers; each engine owns a SearchGroup and table, so neither games
+   nor the two sides share search state. Games are written as PGN, and the summary
+   gives throughput and A's result with an Elo estimate. Needs libm (-lm), so it
+   is left out of the perft build. */
+#ifndef CATUR_PERFT
+const char *defaultOpenings[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "rnbqkbnr/pppp1ppp/8/4p3/4P3/8/PPPP1PPP/RNBQKBNR w KQkq - 0 2",   // 1.e4 e5
+    "rnbqkbnr/pp1ppppp/8/2p5/4P3/8/PPPP1PPP/RNBQKBNR w KQkq - 0 2",   // Sicilian
+    "rnbqkbnr/pppp1ppp/4p3/8/4P3/8/PPPP1PPP/RNBQKBNR w KQkq - 0 2",   // French
+    "rnbqkbnr/pp1ppppp/2p5/8/4P3/8/PPPP1PPP/RNBQKBNR w KQkq - 0 2",   // Caro-Kann
+    "rnbqkbnr/ppp1pppp/8/3p4/2PP4/8/PP2PPPP/RNBQKBNR b KQkq - 0 2",   // Queen's Gambit
+    "rnbqkb1r/pppppppp/5n2/8/3P4/8/PPP1PPPP/RNBQKBNR w KQkq - 1 2",   // 1.d4 Nf6
+    "rnbqkbnr/pppppppp/8/8/2P5/8/PP1PPPPP/RNBQKBNR b KQkq - 0 1",     // English
+};
+
+typedef struct {
+    SearchLimits limA, limB;
+    int games, concurrency, maxPlies; size_t hashMb;
+    const char **openings; int openingCount;
+    FILE *pgn;
+    atomic_int nextGame;
+    pthread_mutex_t lock;            // guards the totals, the PGN file and stdout
+    int wins, draws, losses, done;   // from A's point of view
+    long long moves, moveMs, nodes;
+} SelfPlay;
+
+const char *resultStr(int res) { return res==RESULT_WHITE ? "1-0" : res==RESULT_BLACK ? "0-1" : res==RESULT_DRAW ? "1/2-1/2" : "*"; }
+
+// the game record as a PGN game (tags, SAN movetext, result)
+void writePgn(FILE *f, const Game *g, const char *white, const char *black, int round, int res, const char *why) {
+    char fen[FEN_MAX], date[16]; time_t now = time(NULL);
+    strftime(date, sizeof(date), "%Y.%m.%d", localtime(&now));
+    toFen(&g->startPos, g->startSide, fen);
+    fprintf(f, "[Event \"Catur self-play\"]\n[Site \"?\"]\n[Date \"%s\"]\n[Round \"%d\"]\n", date, round);
+    fprintf(f, "[White \"%s\"]\n[Black \"%s\"]\n[Result \"%s\"]\n", white, black, resultStr(res));
+    if (strcmp(fen, "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1")) fprintf(f, "[SetUp \"1\"]\n[FEN \"%s\"]\n", fen);
+    fprintf(f, "[PlyCount \"%d\"]\n\n", g->historyCount);
+    Position pos = g->startPos; char side = g->startSide; int col = 0;
+    for (int i=0;i<g->historyCount;i++) {
+        char tok[32], san[16]; int n = 0;
+        if (side=='w') n = sprintf(tok, "%d. ", pos.fullmoveNumber);
+        else if (i==0) n = sprintf(tok, "%d... ", pos.fullmoveNumber);
+        moveToSan(&pos, side, g->moves[i], san); sprintf(tok+n, "%s", san);
+        int len = (int)strlen(tok);
+        if (col+len+1 > 79) { fputc('\n', f); col = 0; } else if (col) { fputc(' ', f); col++; }
+        fputs(tok, f); col += len;
+        Move m; playMove(&pos, g->moves[i], &m); side = side=='w' ? 'b' : 'w';
+    }
+    if (why && *why) fprintf(f, "%s{%s}", col ? " " : "", why);
+    fprintf(f, " %s\n\n", resultStr(res));
+}
+
+// Elo difference that corresponds to scoring fraction p
+double eloFromScore(double p) { return 400.0*log10(p/(1.0-p)); }
+
+void playSelfPlayGame(SelfPlay *sp, int idx, Game *g, SearchGroup *engA, SearchGroup *engB) {
+    int aWhite = idx%2==0; const char *why = ""; int res = RESULT_NONE;
+    long long moves = 0, moveMs = 0, nodes = 0;
+    int *times = malloc(sp->maxPlies*sizeof(int)); // per-move wall time for the stats; skipped when out of memory
+    initGameFromFen(g, sp->openings[(idx/2) % sp->openingCount]);
+    ttClear(engA->tt); ttClear(engB->tt);
+    while (1) {
+        char side = sideToMove(g);
+        if ((res = gameOutcome(g, side, &why))!=RESULT_NONE) break;
+        if (g->historyCount>=sp->maxPlies) { res = RESULT_DRAW; why = "Draw by move limit"; break; }
+        // adjudication, not a rule: engines only shuffle on in a position the tables call drawn
+        int plies;
+        if (tbProbe(&g->pos, side, &plies)==TB_DRAW) { res = RESULT_DRAW; why = "Draw by tablebase"; break; }
+        int aToMove = (side=='w')==aWhite; SearchGroup *eng = aToMove ? engA : engB; PackedMove pm;
+        long long t0 = nowMs();
+        searchBestMove(eng, &g->pos, side, g->keys, g->historyCount+1, aToMove ? &sp->limA : &sp->limB, &pm, NULL);
+        long long ms = nowMs()-t0;
+        if (times) times[moves] = (int)ms;
+        moveMs += ms; nodes += totalNodes(eng); moves++;
+        commitMove(g, pm);
+    }
+    if (times) { statGameMoveTimes(times, (int)moves); free(times); }
+    pthread_mutex_lock(&sp->lock);
+    int aScore = res==RESULT_DRAW ? 0 : (res==RESULT_WHITE)==aWhite ? 1 : -1;
+    if (aScore>0) sp->wins++; else if (aScore<0) sp->losses++; else sp->draws++;
+    sp->moves += moves; sp->moveMs += moveMs; sp->nodes += nodes; sp->done++;
+    if (sp->pgn) { writePgn(sp->pgn, g, aWhite ? "Catur A" : "Catur B", aWhite ? "Catur B" : "Catur A", idx+1, res, why); fflush(sp->pgn); }
+    printf("Partai %d/%d (%d selesai): %s vs %s %s, %d ply, %s\n", idx+1, sp->games, sp->done,
+           aWhite ? "A" : "B", aWhite ? "B" : "A", resultStr(res), g->historyCount, why);
+    fflush(stdout);
+    pthread_mutex_unlock(&sp->lock);
+}
+
+void *selfPlayWorker(void *arg) {
+    SelfPlay *sp = (SelfPlay*)arg;
+    SearchGroup *engA = newSearchGroup(sp->limA.threads, sp->hashMb), *engB = newSearchGroup(sp->limB.threads, sp->hashMb);
+    Game *g = malloc(sizeof(Game));
+    if (!engA || !engB || !g) { fprintf(stderr, "Memori tidak cukup untuk satu pekerja self-play.\n"); }
+    else for (int idx; (idx = atomic_fetch_add(&sp->nextGame, 1)) < sp->games; ) playSelfPlayGame(sp, idx, g, engA, engB);
+    freeSearchGroup(engA); freeSearchGroup(engB); free(g);
+    return NULL;
+}
+
+// catur --selfplay [--games N] [--concurrency N] [--movetime ms] [--nodes N] [--depth N] [--threads N]
+//                  [--hash MB] [--maxplies N] [--openings file] [--pgn file] [--b-movetime ms] [--b-nodes N] [--b-depth N]
+int selfPlayMain(int argc, char **argv) {
+    static SelfPlay sp;
+    SearchLimits lim = {0, 0, 0, 0, 1};
+    long long bTime = -1, bNodes = -1, bDepth = -1;
+    const char *openFile = NULL, *pgnFile = "selfplay.pgn";
+    sp.games = 0; sp.concurrency = cpuCount(); sp.maxPlies = 400; sp.hashMb = 16;
+    for (int i=0;i<argc;i++) {
+        const char *opt = argv[i], *val = i+1<argc ? argv[i+1] : NULL;
+        if (!val) { fprintf(stderr, "Opsi %s butuh nilai.\n", opt); return 2; }
+        i++;
+        if (!strcmp(opt,"--games")) sp.games = atoi(val);
+        else if (!strcmp(opt,"--concurrency")) sp.concurrency = atoi(val);
+        else if (!strcmp(opt,"--movetime")) lim.moveTimeMs = atoi(val);
+        else if (!strcmp(opt,"--nodes")) lim.nodeLimit = atoll(val);
+        else if (!strcmp(opt,"--depth")) lim.maxDepth = atoi(val);
+        else if (!strcmp(opt,"--threads")) lim.threads = atoi(val);
+        else if (!strcmp(opt,"--hash")) sp.hashMb = (size_t)atoll(val);
+        else if (!strcmp(opt,"--maxplies")) sp.maxPlies = atoi(val);
+        else if (!strcmp(opt,"--openings")) openFile = val;
+        else if (!strcmp(opt,"--pgn")) pgnFile = val;
+        else if (!strcmp(opt,"--b-movetime")) bTime = atoll(val);
+        else if (!strcmp(opt,"--b-nodes")) bNodes = atoll(val);
+        else if (!strcmp(opt,"--b-depth")) bDepth = atoll(val);
+        else { fprintf(stderr, "Opsi tidak dikenal: %s\n", opt); return 2; }
+    }
+    if (!lim.moveTimeMs && !lim.nodeLimit && !lim.maxDepth) lim.moveTimeMs = 100;
+    lim.threads = lim.threads<1 ? 1 : lim.threads>MAX_THREADS ? MAX_THREADS : lim.threads;
+    if (sp.maxPlies<1 || sp.maxPlies>MAX_HISTORY) sp.maxPlies = MAX_HISTORY;
+    sp.limA = sp.limB = lim;
+    if (bTime>=0) sp.limB.moveTimeMs = (int)bTime;
+    if (bNodes>=0) sp.limB.nodeLimit = bNodes;
+    if (bDepth>=0) sp.limB.maxDepth = (int)bDepth;
+
+    // openings: one FEN (or EPD line) per line, '#' starts a comment
+    sp.openings = defaultOpenings; sp.openingCount = (int)(sizeof(defaultOpenings)/sizeof(defaultOpenings[0]));
+    if (openFile) {
+        FILE *f = fopen(openFile, "r"); char line[256]; int cap = 0; Position tmp;
+        if (!f) { fprintf(stderr, "Tidak bisa membuka %s\n", openFile); return 2; }
+        sp.openings = NULL; sp.openingCount = 0;
+        while (fgets(line, sizeof(line), f)) {
+            line[strcspn(line, "\r\n")] = '\0';
+            if (!line[0] || line[0]=='#') continue;
+            if (!loadFen(&tmp, line, NULL)) { fprintf(stderr, "FEN tidak valid di %s: %s\n", openFile, line); fclose(f); return 2; }
+            if (sp.openingCount==cap) { cap = cap ? cap*2 : 64; sp.openings = realloc(sp.openings, cap*sizeof(char*)); }
+            sp.openings[sp.openingCount++] = strdup(line);
+        }
+        fclose(f);
+        if (!sp.openingCount) { fprintf(stderr, "Tidak ada posisi pembuka di %s\n", openFile); return 2; }
+    }
+    if (sp.games<1) sp.games = 2*sp.openingCount;
+    if (sp.concurrency<1) sp.concurrency = 1;
+    if (sp.concurrency>sp.games) sp.concurrency = sp.games;
+    if (pgnFile[0] && !(sp.pgn = fopen(pgnFile, "w"))) { fprintf(stderr, "Tidak bisa menulis %s\n", pgnFile); return 2; }
+    pthread_mutex_init(&sp.lock, NULL); atomic_store(&sp.nextGame, 0);
+    while (!atomic_load(&tbReady)) sleepMs(10); // adjudication must not depend on how soon a game gets there
+
+    printf("Self-play: %d partai, %d sekaligus, %d pembuka; A: %d ms / %lld node / depth %d, B: %d ms / %lld node / depth %d\n",
+           sp.games, sp.concurrency, sp.openingCount, sp.limA.moveTimeMs, sp.limA.nodeLimit, sp.limA.maxDepth,
+           sp.limB.moveTimeMs, sp.limB.nodeLimit, sp.limB.maxDepth);
+    long long t0 = nowMs();
+    pthread_t *tids = malloc(sp.concurrency*sizeof(pthread_t)); int started = 0;
+    pthread_attr_t attr; pthread_attr_init(&attr); pthread_attr_setstacksize(&attr, 8u<<20);
+    for (int i=0;i<sp.concurrency;i++) { if (pthread_create(&tids[started], &attr, selfPlayWorker, &sp)!=0) break; started++; }
+    pthread_attr_destroy(&attr);
+    if (!started) selfPlayWorker(&sp);
+    for (int i=0;i<started;i++) pthread_join(tids[i], NULL);
+    free(tids);
+    double secs = (nowMs()-t0)/1000.0; if (secs<=0) secs = 0.001;
+    if (sp.pgn) fclose(sp.pgn);
+
+    int n = sp.wins+sp.draws+sp.losses;
+    printf("\nSelesai: %d partai dalam %.1f s (%.2f partai/detik)\n", n, secs, n/secs);
+    if (sp.moves) printf("Rata-rata per langkah: %.1f ms, %lld node (%.0f nps)\n",
+                         (double)sp.moveMs/sp.moves, sp.nodes/sp.moves, sp.moveMs ? sp.nodes*1000.0/sp.moveMs : 0.0);
+    if (!n) return 1;
+    double p = (sp.wins + 0.5*sp.draws)/n;
+    printf("A vs B: +%d =%d -%d, skor %.1f%%\n", sp.wins, sp.draws, sp.losses, 100*p);
+    // 95% interval from the per-game score variance; one extra win and one extra loss
+    // (as in Agresti-Coull) keep it from collapsing to +/- 0 when every game is drawn
+    double w = sp.wins+1, l = sp.losses+1, q = (w + 0.5*sp.draws)/(n+2);
+    double var = (w*(1-q)*(1-q) + sp.draws*(0.5-q)*(0.5-q) + l*q*q)/(n+2), se = sqrt(var/n);
+    double lo = p-1.96*se, hi = p+1.96*se;
+    if (p<=0 || p>=1) printf("Elo A-B: tidak terhingga (semua partai menang/kalah)\n");
+    else if (n<10 || lo<=0 || hi>=1) printf("Elo A-B: %+.0f (interval terlalu lebar, tambah jumlah partai)\n", eloFromScore(p));
+    else printf("Elo A-B: %+.0f +/- %.0f (95%%)\n", eloFromScore(p), (eloFromScore(hi)-eloFromScore(lo))/2);
+    return 0;
+}
+#endif
+
+/* ===== PGN replay and validation (--pgn-check) =====
+   Streams a PGN archive through the same rules as live play: every SAN move must
+   match exactly one move of generateLegalMoves and is applied with playMove
+   (makeMoveStruct). The reader fread()s big chunks and cuts them into batches of
+   whole games; worker threads replay the batches and report each broken game. */
+#define PGN_CHUNK (4u<<20)          // bytes per fread
+#define PGN_BATCH (1u<<20)          // a batch is closed at the first game start past this size
+#define PGN_QUEUE 16                // batches in flight
+
+typedef struct { char *text; size_t len, cap; long firstGame; } PgnBatch;
+
+typedef struct {
+    PgnBatch *slots[PGN_QUEUE]; int head, count, done;
+    pthread_mutex_t lock; pthread_cond_t notEmpty, notFull;
+    atomic_long games, badGames, moves;
+} PgnReplay;
+
+// line-level game splitter shared by the reader and the workers, so both agree on numbering
+typedef struct { int gameOpen, inMoves, inComment; } PgnSplit;
+
+// does this line start a new game? A tag line after movetext (or the first line with content) does
+int pgnStartsGame(PgnSplit *st, const char *line, size_t len) {
+    if (!st->inComment && len && line[0]=='[') {
+        int starts = !st->gameOpen || st->inMoves;
+        st->gameOpen = 1; st->inMoves = 0; return starts;
+    }
+    if (len && line[0]=='%') return 0; // escape line
+    int content = 0;
+    for (size_t i=0;i<len;i++) {
+        char ch = line[i];
+        if (st->inComment) { content = 1; if (ch=='}') st->inComment = 0; }
+        else if (ch=='{') { content = 1; st->inComment = 1; }
+        else if (ch==';') break;
+        else if (!isspace((unsigned char)ch)) content = 1;
+    }
+    if (!content) return 0;
+    int starts = !st->gameOpen;
+    st->gameOpen = 1; st->inMoves = 1;
+    return starts;
+}
+
+// called before each replayed move (ply counts from the game's start position)
+typedef void (*PgnMoveFn)(void *ctx, const Position *pos, char side, PackedMove pm, int ply);
+
+// replay one game; returns the plies played, or -1 with err filled in
+int replayPgnGame(const char *p, const char *end, char *err, size_t errLen, PgnMoveFn onMove, void *ctx) {
+    Position pos; char side;
+    loadFen(&pos, "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", &side);
+    int plies = 0;
+    while (p<end) {
+        char ch = *p;
+        if (isspace((unsigned char)ch)) { p++; continue; }
+        if (ch=='[') {
+            // tag pair; only FEN changes how the game is replayed
+            const char *eol = memchr(p, '\n', end-p); if (!eol) eol = end;
+            if (plies==0 && eol-p>6 && !strncmp(p, "[FEN \"", 6)) {
+                char fen[FEN_MAX+8]; size_t n = 0;
+                for (const char *q=p+6; q<eol && *q!='"' && n<sizeof(fen)-1; q++) fen[n++] = *q;
+                fen[n] = '\0';
+                if (!loadFen(&pos, fen, &side)) { snprintf(err, errLen, "FEN tidak valid: %s", fen); return -1; }
+            }
+            p = eol; continue;
+        }
+        if (ch=='{') { const char *q = memchr(p, '}', end-p); p = q ? q+1 : end; continue; }
+        if (ch==';' || (ch=='%' && (p==end || p[-1]=='\n'))) { const char *q = memchr(p, '\n', end-p); p = q ? q : end; continue; }
+        if (ch=='(') { // variations are skipped, nested ones included
+            int depth = 0;
+            for (; p<end; p++) {
+                if (*p=='{') { const char *q = memchr(p, '}', end-p); p = q ? q : end-1; }
+                else if (*p=='(') depth++;
+                else if (*p==')' && --depth==0) { p++; break; }
+            }
+            continue;
+        }
+        if (ch=='$') { p++; while (p<end && isdigit((unsigned char)*p)) p++; continue; }
+        char tok[32]; int n = 0;
+        while (p<end && !isspace((unsigned char)*p) && !strchr("{}();[", *p)) { if (n<31) tok[n++] = *p; p++; }
+        tok[n] = '\0';
+        if (!n) { p++; continue; }
+        if (!strcmp(tok,"1-0") || !strcmp(tok,"0-1") || !strcmp(tok,"1/2-1/2") || !strcmp(tok,"*")) break;
+        char *mv = tok;
+        if (strncmp(tok, "0-0", 3)) { while (isdigit((unsigned char)*mv)) mv++; while (*mv=='.') mv++; } // "12." / "12..." / "12.e4"
+        if (!*mv) continue;
+        PackedMove pm = parseSan(&pos, side, mv);
+        if (pm==NO_MOVE) {
+            snprintf(err, errLen, "langkah %d%s %s tidak sah", pos.fullmoveNumber, side=='w' ? "." : "...", mv);
+            return -1;
+        }
+        if (onMove) onMove(ctx, &pos, side, pm, plies);
+        Move m; playMove(&pos, pm, &m); side = side=='w' ? 'b' : 'w'; plies++;
+    }
+    return plies;
+}
+
+// replay every game of a batch, cut with the same splitter the reader used; errors go to stderr
+void replayPgnBatch(const PgnBatch *b, PgnMoveFn onMove, void *ctx, long *games, long *bad, long *moves) {
+    PgnSplit st = {0, 0, 0}; long gameNo = b->firstGame-1;
+    const char *end = b->text+b->len, *gameStart = NULL;
+    *games = *bad = *moves = 0;
+    for (const char *line = b->text; ; ) {
+        const char *eol = line<end ? memchr(line, '\n', end-line) : NULL; if (!eol) eol = end;
+        int starts = line<end && pgnStartsGame(&st, line, eol-line);
+        if ((starts || line>=end) && gameStart) {
+            char err[128]; int plies = replayPgnGame(gameStart, line, err, sizeof(err), onMove, ctx);
+            (*games)++;
+            if (plies<0) { (*bad)++; fprintf(stderr, "Partai %ld: %s\n", gameNo, err); } else *moves += plies;
+        }
+        if (starts) { gameStart = line; gameNo++; }
+        if (line>=end) break;
+        line = eol<end ? eol+1 : end;
+    }
+}
+
+void *pgnReplayWorker(void *arg) {
+    PgnReplay *r = (PgnReplay*)arg;
+    while (1) {
+        pthread_mutex_lock(&r->lock);
+        while (!r->count && !r->done) pthread_cond_wait(&r->notEmpty, &r->lock);
+        if (!r->count) { pthread_mutex_unlock(&r->lock); return NULL; }
+        PgnBatch *b = r->slots[r->head]; r->head = (r->head+1)%PGN_QUEUE; r->count--;
+        pthread_cond_signal(&r->notFull);
+        pthread_mutex_unlock(&r->lock);
+        long games, bad, moves; replayPgnBatch(b, NULL, NULL, &games, &bad, &moves);
+        atomic_fetch_add(&r->games, games); atomic_fetch_add(&r->badGames, bad); atomic_fetch_add(&r->moves, moves);
+        free(b->text); free(b);
+    }
+}
+
+void pgnPushBatch(void *ctx, PgnBatch *b) {
+    PgnReplay *r = (PgnReplay*)ctx;
+    pthread_mutex_lock(&r->lock);
+    while (r->count==PGN_QUEUE) pthread_cond_wait(&r->notFull, &r->lock);
+    r->slots[(r->head+r->count)%PGN_QUEUE] = b; r->count++;
+    pthread_cond_signal(&r->notEmpty);
+    pthread_mutex_unlock(&r->lock);
+}
+
+PgnBatch *pgnNewBatch(long firstGame) {
+    PgnBatch *b = malloc(sizeof(PgnBatch));
+    b->cap = PGN_BATCH + PGN_BATCH/4; b->text = malloc(b->cap); b->len = 0; b->firstGame = firstGame;
+    return b;
+}
+
+void pgnAppend(PgnBatch *b, const char *s, size_t n) {
+    if (b->len+n > b->cap) { while (b->len+n > b->cap) b->cap *= 2; b->text = realloc(b->text, b->cap); }
+    memcpy(b->text+b->len, s, n); b->len += n;
+}
+
+// stream f in PGN_CHUNK reads and hand whole-game batches (about PGN_BATCH bytes) to sink,
+// which takes ownership; returns the bytes read
+long long pgnReadBatches(FILE *f, void (*sink)(void *ctx, PgnBatch *b), void *ctx) {
+    long long bytes = 0; long games = 0;
+    size_t cap = 2*PGN_CHUNK, have = 0; char *buf = malloc(cap);
+    PgnSplit st = {0, 0, 0}; PgnBatch *b = pgnNewBatch(1);
+    while (1) {
+        if (cap-have < PGN_CHUNK) { cap *= 2; buf = realloc(buf, cap); } // a line longer than a chunk
+        size_t got = fread(buf+have, 1, PGN_CHUNK, f);
+        have += got; bytes += got;
+        int eof = got==0;
+        // hand out complete lines; the tail without '\n' waits for the next chunk (or EOF)
+        size_t pos = 0;
+        while (pos<have) {
+            const char *nl = memchr(buf+pos, '\n', have-pos);
+            if (!nl && !eof) break;
+            size_t len = nl ? (size_t)(nl-(buf+pos))+1 : have-pos;
+            if (pgnStartsGame(&st, buf+pos, len)) {
+                games++;
+                if (b->len>=PGN_BATCH) { sink(ctx, b); b = pgnNewBatch(games); }
+            }
+            pgnAppend(b, buf+pos, len); pos += len;
+        }
+        memmove(buf, buf+pos, have-pos); have -= pos;
+        if (eof) break;
+    }
+    if (b->len) sink(ctx, b); else { free(b->text); free(b); }
+    free(buf);
+    return bytes;
+}
+
+/* book building: the first plies of every game become (key, move) entries, weight = times played */
+typedef struct { U64 key; unsigned short move; unsigned count; } BookEntry;
+typedef struct { BookEntry *e; size_t n, cap; int maxPlies; long games, bad, moves; } BookBuilder;
+
+void bookCollectMove(void *ctx, const Position *pos, char side, PackedMove pm, int ply) {
+    BookBuilder *bb = (BookBuilder*)ctx;
+    if (ply>=bb->maxPlies) return;
+    if (bb->n==bb->cap) { bb->cap = bb->cap ? bb->cap*2 : 1<<16; bb->e = realloc(bb->e, bb->cap*sizeof(BookEntry)); }
+    bb->e[bb->n].key = polyglotKey(pos, side); bb->e[bb->n].move = toBookMove(pm); bb->e[bb->n].count = 1; bb->n++;
+}
+
+void bookCollectBatch(void *ctx, PgnBatch *b) {
+    BookBuilder *bb = (BookBuilder*)ctx; long games, bad, moves;
+    replayPgnBatch(b, bookCollectMove, bb, &games, &bad, &moves);
+    bb->games += games; bb->bad += bad; bb->moves += moves;
+    free(b->text); free(b);
+}
+
+int cmpBookEntry(const void *a, const void *b) {
+    const BookEntry *x = a, *y = b;
+    return x->key!=y->key ? (x->key<y->key ? -1 : 1) : (int)x->move-(int)y->move;
+}
+
+// catur --make-book <in.pgn | -> <out.bin> [--plies N]; broken games are skipped from the move they break on
+int makeBookMain(int argc, char **argv) {
+    BookBuilder bb = {NULL, 0, 0, 20, 0, 0, 0};
+    const char *in = NULL, *out = NULL;
+    for (int i=0;i<argc;i++) {
+        if (!strcmp(argv[i],"--plies") && i+1<argc) bb.maxPlies = atoi(argv[++i]);
+        else if (!in) in = argv[i]; else out = argv[i];
+    }
+    if (!in || !out) { fprintf(stderr, "Pemakaian: catur --make-book <file.pgn | -> <buku.bin> [--plies N]\n"); return 2; }
+    FILE *f = strcmp(in,"-") ? fopen(in, "rb") : stdin;
+    if (!f) { fprintf(stderr, "Tidak bisa membuka %s\n", in); return 2; }
+    pgnReadBatches(f, bookCollectBatch, &bb);
+    if (f!=stdin) fclose(f);
+    // merge repeats of the same (position, move)
+    qsort(bb.e, bb.n, sizeof(BookEntry), cmpBookEntry);
+    size_t m = 0;
+    for (size_t i=0;i<bb.n;i++) {
+        if (m && bb.e[m-1].key==bb.e[i].key && bb.e[m-1].move==bb.e[i].move) bb.e[m-1].count++;
+        else bb.e[m++] = bb.e[i];
+    }
+    FILE *o = fopen(out, "wb");
+    if (!o) { fprintf(stderr, "Tidak bisa menulis %s\n", out); free(bb.e); return 2; }
+    for (size_t i=0;i<m;i++) {
+        unsigned char e[16]; unsigned w = bb.e[i].count>65535 ? 65535 : bb.e[i].count;
+        for (int k=0;k<8;k++) e[k] = (unsigned char)(bb.e[i].key>>(56-8*k));
+        e[8] = bb.e[i].move>>8; e[9] = bb.e[i].move&255; e[10] = w>>8; e[11] = w&255;
+        memset(e+12, 0, 4);
+        fwrite(e, 1, 16, o);
+    }
+    fclose(o); free(bb.e);
+    printf("Buku %s: %zu entri dari %ld partai (%ld bermasalah), %d ply pertama\n", out, m, bb.games, bb.bad, bb.maxPlies);
+    return 0;
+}
+
+// catur --pgn-check <file.pgn | -> [--threads N]; per-game errors go to stderr
+int pgnReplayMain(int argc, char **argv) {
+    static PgnReplay r;
+    const char *file = NULL; int threads = cpuCount();
+    for (int i=0;i<argc;i++) {
+        if (!strcmp(argv[i],"--threads") && i+1<argc) threads = atoi(argv[++i]);
+        else file = argv[i];
+    }
+    if (!file) { fprintf(stderr, "Pemakaian: catur --pgn-check <file.pgn | -> [--threads N]\n"); return 2; }
+    FILE *f = strcmp(file,"-") ? fopen(file, "rb") : stdin;
+    if (!f) { fprintf(stderr, "Tidak bisa membuka %s\n", file); return 2; }
+    threads = threads<1 ? 1 : threads>MAX_THREADS ? MAX_THREADS : threads;
+    pthread_mutex_init(&r.lock, NULL); pthread_cond_init(&r.notEmpty, NULL); pthread_cond_init(&r.notFull, NULL);
+    pthread_t tids[MAX_THREADS]; int started = 0;
+    for (int i=0;i<threads;i++) { if (pthread_create(&tids[started], NULL, pgnReplayWorker, &r)!=0) break; started++; }
+
+    long long t0 = nowMs(), bytes = pgnReadBatches(f, pgnPushBatch, &r);
+    if (f!=stdin) fclose(f);
+    pthread_mutex_lock(&r.lock); r.done = 1; pthread_cond_broadcast(&r.notEmpty); pthread_mutex_unlock(&r.lock);
+    if (!started) pgnReplayWorker(&r);
+    for (int i=0;i<started;i++) pthread_join(tids[i], NULL);
+
+    double secs = (nowMs()-t0)/1000.0; if (secs<=0) secs = 0.001;
+    long nGames = atomic_load(&r.games), nBad = atomic_load(&r.badGames), nMoves = atomic_load(&r.moves);
+    printf("Partai: %ld (sah %ld, bermasalah %ld), langkah: %ld\n", nGames, nGames-nBad, nBad, nMoves);
+    printf("Waktu: %.2f s, %.0f langkah/detik, %.1f MB/detik, %d thread\n", secs, nMoves/secs, bytes/1048576.0/secs, started ? started : 1);
+    return nBad ? 1 : 0;
+}
+
+/* ===== EPD test suites (--analyze) =====
+   Runs an EPD file of test positions, each with "bm" (best move) and/or "am"
+   (avoid move) operations, through the search under a fixed time, depth or node
+   limit. Positions are handed to a pool of workers, one position per worker at a
+   time; each worker owns a single-threaded SearchGroup, so searches share nothing.
+   The main thread of each search reports every finished iteration, which gives
+   the time to solution: when the best move became a solution and stayed one. */
+#define MAX_EPD_MOVES 8
+
+typedef struct {
+    Position pos; char side;
+    char id[48];
+    PackedMove bm[MAX_EPD_MOVES], am[MAX_EPD_MOVES]; int nbm, nam;
+    PackedMove played; int solved, depth, solveDepth;   // results
+    long long ms, solveMs, nodes;                       // solveMs -1: not (yet) solved
+} EpdPos;
+
+typedef struct {
+    EpdPos *pos; int count, workers;
+    SearchLimits lim; size_t hashMb;
+    atomic_int next;
+    pthread_mutex_t lock;            // guards the totals and stdout
+    int done, solved;
+    long long nodes, searchMs, solveMs;
+} Analyze;
+
+// "fen4 opcode operand...; opcode operand...;" into e; 0 with a reason in err
+int parseEpdLine(const char *line, EpdPos *e, char *err, int errLen) {
+    char fen[FEN_MAX]; const char *p = line; int n = 0;
+    memset(e, 0, sizeof(*e)); e->played = NO_MOVE; e->solveMs = -1;
+    // the first four fields are a FEN without the clocks
+    for (int f=0;f<4;f++) {
+        while (*p==' ' || *p=='\t') p++;
+        if (!*p) { snprintf(err, errLen, "kurang dari 4 kolom FEN"); return 0; }
+        while (*p && *p!=' ' && *p!='\t') { if (n<FEN_MAX-2) fen[n++] = *p; p++; }
+        fen[n++] = ' ';
+    }
+    fen[n-1] = '\0';
+    if (!loadFen(&e->pos, fen, &e->side)) { snprintf(err, errLen, "FEN tidak valid: %s", fen); return 0; }
+    while (*p) {
+        while (*p==' ' || *p=='\t' || *p==';') p++;
+        if (!*p) break;
+        char opcode[16]; int k = 0;
+        while (*p && *p!=' ' && *p!='\t' && *p!=';') { if (k<15) opcode[k++] = *p; p++; }
+        opcode[k] = '\0';
+        // operands up to the ';' that ends the operation; strings are quoted
+        while (*p && *p!=';') {
+            while (*p==' ' || *p=='\t') p++;
+            if (!*p || *p==';') break;
+            char tok[48]; k = 0;
+            if (*p=='"') { p++; while (*p && *p!='"') { if (k<47) tok[k++] = *p; p++; } if (*p) p++; }
+            else while (*p && *p!=' ' && *p!='\t' && *p!=';') { if (k<47) tok[k++] = *p; p++; }
+            tok[k] = '\0';
+            if (!strcmp(opcode,"id")) snprintf(e->id, sizeof(e->id), "%s", tok);
+            else if (!strcmp(opcode,"bm") || !strcmp(opcode,"am")) {
+                PackedMove pm = parseSan(&e->pos, e->side, tok);
+                if (pm==NO_MOVE) pm = parseCoordMove(&e->pos, e->side, tok);
+                if (pm==NO_MOVE) { snprintf(err, errLen, "langkah %s tidak sah: %s", opcode, tok); return 0; }
+                if (opcode[0]=='b' && e->nbm<MAX_EPD_MOVES) e->bm[e->nbm++] = pm;
+                else if (opcode[0]=='a' && e->nam<MAX_EPD_MOVES) e->am[e->nam++] = pm;
+            }
+        }
+    }
+    if (!e->nbm && !e->nam) { snprintf(err, errLen, "tidak ada operasi bm atau am"); return 0; }
+    return 1;
+}
+
+// pm solves e: one of the bm moves, or, with only am given, none of the am moves
+int epdSolved(const EpdPos *e, PackedMove pm) {
+    for (int i=0;i<e->nbm;i++) if (e->bm[i]==pm) return 1;
+    if (e->nbm) return 0;
+    for (int i=0;i<e->nam;i++) if (e->am[i]==pm) return 0;
+    return 1;
+}
+
+// SearchGroup.onIteration: restart the solution clock whenever the best move is wrong
+void analyzeIteration(const SearchThread *t, void *ctx) {
+    EpdPos *e = (EpdPos*)ctx;
+    if (!epdSolved(e, t->bestMove)) e->solveMs = -1;
+    else if (e->solveMs<0) { e->solveMs = nowMs()-t->group->startMs; e->solveDepth = t->completedDepth; }
+}
+
+void analyzePosition(Analyze *a, int idx, SearchGroup *sg) {
+    EpdPos *e = &a->pos[idx];
+    ttClear(sg->tt); sg->iterCtx = e;
+    long long t0 = nowMs();
+    int found = searchBestMove(sg, &e->pos, e->side, NULL, 0, &a->lim, &e->played, NULL);
+    e->ms = nowMs()-t0; e->nodes = totalNodes(sg); e->depth = sg->threads[0].completedDepth;
+    e->solved = found && epdSolved(e, e->played);
+    if (!e->solved) e->solveMs = -1;
+    else if (e->solveMs<0) { e->solveMs = e->ms; e->solveDepth = e->depth; }
+
+    char san[16] = "-", want[MAX_EPD_MOVES*2*10+8]; int n = 0;
+    if (found) moveToSan(&e->pos, e->side, e->played, san);
+    for (int i=0;i<e->nbm;i++) { char s[16]; moveToSan(&e->pos, e->side, e->bm[i], s); n += sprintf(want+n, "%s%s", i ? " " : "bm ", s); }
+    for (int i=0;i<e->nam;i++) { char s[16]; moveToSan(&e->pos, e->side, e->am[i], s); n += sprintf(want+n, "%s%s", i ? " " : n ? ", am " : "am ", s); }
+    want[n] = '\0';
+    pthread_mutex_lock(&a->lock);
+    a->done++; a->nodes += e->nodes; a->searchMs += e->ms;
+    if (e->solved) { a->solved++; a->solveMs += e->solveMs; }
+    printf("Posisi %d/%d %s: %-5s %s (%s), depth %d, %lld node", idx+1, a->count, e->id, e->solved ? "OK" : "GAGAL", san, want, e->depth, e->nodes);
+    if (e->solved) printf(", solusi %lld ms di depth %d", e->solveMs, e->solveDepth);
+    printf("\n"); fflush(stdout);
+    pthread_mutex_unlock(&a->lock);
+}
+
+void *analyzeWorker(void *arg) {
+    Analyze *a = (Analyze*)arg;
+    SearchGroup *sg = newSearchGroup(1, a->hashMb);
+    if (!sg) fprintf(stderr, "Memori tidak cukup untuk satu pekerja analisis.\n");
+    else {
+        sg->onIteration = analyzeIteration;
+        for (int idx; (idx = atomic_fetch_add(&a->next, 1)) < a->count; ) analyzePosition(a, idx, sg);
+    }
+    freeSearchGroup(sg);
+    return NULL;
+}
+
+// catur --analyze <file.epd | -> [--movetime ms] [--depth N] [--nodes N] [--workers N] [--hash MB]
+int analyzeMain(int argc, char **argv) {
+    static Analyze a;
+    SearchLimits lim = {0, 0, 0, 0, 1};
+    const char *file = NULL;
+    a.workers = cpuCount(); a.hashMb = 16;
+    for (int i=0;i<argc;i++) {
+        const char *opt = argv[i], *val = i+1<argc ? argv[i+1] : NULL;
+        if (opt[0]!='-' || !opt[1]) { file = opt; continue; }
+        if (!val) { fprintf(stderr, "Opsi %s butuh nilai.\n", opt); return 2; }
+        i++;
+        if (!strcmp(opt,"--movetime")) lim.moveTimeMs = atoi(val);
+        else if (!strcmp(opt,"--depth")) lim.maxDepth = atoi(val);
+        else if (!strcmp(opt,"--nodes")) lim.nodeLimit = atoll(val);
+        else if (!strcmp(opt,"--workers")) a.workers = atoi(val);
+        else if (!strcmp(opt,"--hash")) a.hashMb = (size_t)atoll(val);
+        else { fprintf(stderr, "Opsi tidak dikenal: %s\n", opt); return 2; }
+    }
+    if (!file) { fprintf(stderr, "Pemakaian: catur --analyze <file.epd | -> [--movetime ms] [--depth N] [--nodes N] [--workers N] [--hash MB]\n"); return 2; }
+    if (!lim.moveTimeMs && !lim.nodeLimit && !lim.maxDepth) lim.moveTimeMs = 1000;
+    a.lim = lim;
+
+    // one position per line, '#' starts a comment; bad lines are reported and skipped
+    FILE *f = strcmp(file,"-") ? fopen(file, "r") : stdin;
+    if (!f) { fprintf(stderr, "Tidak bisa membuka %s\n", file); return 2; }
+    char line[1024], err[128]; int cap = 0, lineNo = 0, skipped = 0;
+    while (fgets(line, sizeof(line), f)) {
+        lineNo++; line[strcspn(line, "\r\n")] = '\0';
+        if (!line[0] || line[0]=='#') continue;
+        if (a.count==cap) { cap = cap ? cap*2 : 64; a.pos = realloc(a.pos, cap*sizeof(EpdPos)); }
+        EpdPos *e = &a.pos[a.count];
+        if (!parseEpdLine(line, e, err, sizeof(err))) { fprintf(stderr, "Baris %d dilewati: %s\n", lineNo, err); skipped++; continue; }
+        if (!e->id[0]) snprintf(e->id, sizeof(e->id), "#%d", lineNo);
+        a.count++;
+    }
+    if (f!=stdin) fclose(f);
+    if (!a.count) { fprintf(stderr, "Tidak ada posisi di %s\n", file); return 2; }
+    if (a.workers<1) a.workers = 1;
+    if (a.workers>a.count) a.workers = a.count;
+    pthread_mutex_init(&a.lock, NULL); atomic_store(&a.next, 0);
+
+    printf("Analisis: %d posisi, %d pekerja, %d ms / %lld node / depth %d per posisi\n",
+           a.count, a.workers, lim.moveTimeMs, lim.nodeLimit, lim.maxDepth);
+    long long t0 = nowMs();
+    pthread_t *tids = malloc(a.workers*sizeof(pthread_t)); int started = 0;
+    pthread_attr_t attr; pthread_attr_init(&attr); pthread_attr_setstacksize(&attr, 8u<<20);
+    for (int i=0;i<a.workers;i++) { if (pthread_create(&tids[started], &attr, analyzeWorker, &a)!=0) break; started++; }
+    pthread_attr_destroy(&attr);
+    if (!started) analyzeWorker(&a);
+    for (int i=0;i<started;i++) pthread_join(tids[i], NULL);
+    free(tids);
+    double secs = (nowMs()-t0)/1000.0; if (secs<=0) secs = 0.001;
+
+    printf("\nSelesai: %d posisi dalam %.1f s (%.2f posisi/detik)%s", a.done, secs, a.done/secs, skipped ? "" : "\n");
+    if (skipped) printf(", %d baris dilewati\n", skipped);
+    printf("Terpecahkan: %d/%d (%.1f%%)\n", a.solved, a.done, a.done ? 100.0*a.solved/a.done : 0.0);
+    if (a.solved) printf("Waktu ke solusi: rata-rata %.0f ms\n", (double)a.solveMs/a.solved);
+    printf("Node: %lld, %.0f nps gabungan (%.0f nps per pekerja)\n", a.nodes, a.nodes/secs, a.searchMs ? a.nodes*1000.0/a.searchMs : 0.0);
+    if (a.solved<a.done) {
+        printf("Gagal:");
+        for (int i=0;i<a.count;i++) if (!a.pos[i].solved) printf(" %s", a.pos[i].id);
+        printf("\n");
+    }
+    free(a.pos);
+    return a.solved==a.done ? 0 : 1;
+}
+
+/* ===== Endgame table files (--make-tb) ===== */
+// catur --make-tb [dir]: build every 4-piece table and write it as dir/<name>.tb
+int makeTbMain(int argc, char **argv) {
+    const char *dir = argc>0 ? argv[0] : ".";
+    signed char *v = malloc(TB4_SIZE);
+    if (!v) { fprintf(stderr, "Memori tidak cukup untuk membangun tabel.\n"); return 1; }
+    while (!atomic_load(&tbReady)) sleepMs(10); // captures lead into the 3-piece tables
+    for (int t=0;t<TB4_COUNT;t++) {
+        char path[1024]; snprintf(path, sizeof(path), "%s/%s.tb", dir, tb4Names[t]);
+        long long t0 = nowMs(), won = 0, lost = 0, drawn = 0;
+        int longest = buildTable4(t, v);
+        if (longest<0) { fprintf(stderr, "Memori tidak cukup untuk membangun %s.\n", path); free(v); return 1; }
+        for (int i=0;i<TB4_SIZE;i++) { if (v[i]==TB_ILLEGAL) continue; if (v[i]>0) won++; else if (v[i]<0) lost++; else drawn++; }
+        FILE *f = fopen(path, "wb");
+        if (!f || fwrite(v, 1, TB4_SIZE, f)!=TB4_SIZE) { fprintf(stderr, "Tidak bisa menulis %s\n", path); if (f) fclose(f); free(v); return 2; }
+        fclose(f);
+        printf("%s: %lld posisi (menang %lld, kalah %lld, remis %lld), skakmat terpanjang %d ply, %.1f s\n",
+               path, won+lost+drawn, won, lost, drawn, longest, (nowMs()-t0)/1000.0);
+        fflush(stdout);
+    }
+    free(v);
+    return 0;
+}
+
+/* ===== Perft (move generator node counter / regression oracle) ===== */
+// make/unmake on a single position, so perft also validates unmakeMove
+long long perft(Position *pos, int depth, char side) {
+    MoveList ml; generateLegalMoves(pos, side, &ml);
+    if (depth<=1) return ml.count;
+    long long nodes = 0; Move m;
+    for (int i=0;i<ml.count;i++) {
+        playMove(pos, ml.moves[i], &m);
+        nodes += perft(pos, depth-1, side=='w'?'b':'w');
+        unmakeMove(pos, &m);
+    }
+    return nodes;
+}
+
+// per root move counts ("divide"); counts go to stdout, timing to stderr
+long long perftDivide(Position *pos, int depth, char side) {
+    clock_t t0 = clock();
+    MoveList ml; generateLegalMoves(pos, side, &ml);
+    long long total = 0;
+    for (int i=0;i<ml.count;i++) {
+        char mv[8]; moveToStr(ml.moves[i], mv);
+        Move m; playMove(pos, ml.moves[i], &m);
+        long long cnt = depth>1 ? perft(pos, depth-1, side=='w'?'b':'w') : 1;
+        unmakeMove(pos, &m);
+        printf("%s: %lld\n", mv, cnt);
+        total += cnt;
+    }
+    double secs = (double)(clock()-t0)/CLOCKS_PER_SEC;
+    printf("\nNodes: %lld\n", total);
+    fprintf(stderr, "Time: %.3f s | NPS: %.0f\n", secs, secs>0 ? total/secs : 0.0);
+    return total;
+}
+
+typedef struct { const char *name; const char *fen; int depth; long long expected; } PerftCase;
+
+const PerftCase perftSuite[] = {
+    {"startpos",  "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 6, 119060324},
+    {"kiwipete",  "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 5, 193690690},
+    {"ep-pins",   "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 6, 11030083},
+    {"promotion", "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 5, 15833292},
+    {"castle-prm","rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 5, 89941194},
+};
+
+// run the reference suite; returns number of failed positions
+int perftRunSuite() {
+    int failed = 0; long long allNodes = 0; clock_t t0 = clock();
+    for (size_t i=0;i<sizeof(perftSuite)/sizeof(perftSuite[0]);i++) {
+        const PerftCase *pc = &perftSuite[i]; char side; Position pos;
+        loadFen(&pos, pc->fen, &side);
+        long long got = perft(&pos, pc->depth, side);
+        allNodes += got;
+        int ok = (got==pc->expected); if (!ok) failed++;
+        printf("%-10s depth %d: %lld (expected %lld) %s\n", pc->name, pc->depth, got, pc->expected, ok?"OK":"FAIL");
+    }
+    double secs = (double)(clock()-t0)/CLOCKS_PER_SEC;
+    printf("%s\n", failed ? "PERFT FAILED" : "PERFT OK");
+    fprintf(stderr, "Total nodes: %lld | Time: %.3f s | NPS: %.0f\n", allNodes, secs, secs>0 ? allNodes/secs : 0.0);
+    return failed;
+}
+
+// usage: perft                  -> reference suite
+//        perft <depth> [fen]    -> divide from startpos or the given FEN
+int perftMain(int argc, char **argv) {
+    if (argc<2) return perftRunSuite() ? 1 : 0;
+    int depth = atoi(argv[1]);
+    if (depth<1) { fprintf(stderr, "usage: %s [depth [fen]]\n", argv[0]); return 2; }
+    char fen[256] = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+    if (argc>2) {
+        // FEN may arrive as one argument or split over several
+        fen[0]='\0';
+        for (int i=2;i<argc;i++) { if (i>2) strncat(fen," ",sizeof(fen)-strlen(fen)-1); strncat(fen,argv[i],sizeof(fen)-strlen(fen)-1); }
+    }
+    char side; Position pos;
+    if (!loadFen(&pos, fen, &side)) { fprintf(stderr, "FEN tidak valid: %s\n", fen); return 2; }
+    perftDivide(&pos, depth, side);
+    return 0;
 }
 
 /* ===== Menu and main ===== */
+// read one integer answer; keeps the current value on empty / invalid input
+long long askNumber(const char *prompt, long long current) {
+    char line[64]; long long v;
+    printf("%s [%lld]: ", prompt, current); fflush(stdout);
+    if (!fgets(line, sizeof(line), stdin)) return current;
+    return (sscanf(line, "%lld", &v)==1 && v>=0) ? v : current;
+}
+
+void engineSettingsMenu() {
+    printf("=== Pengaturan komputer (0 = tanpa batas) ===\n");
+    engineLimits.moveTimeMs = (int)askNumber("Waktu per langkah (ms)", engineLimits.moveTimeMs);
+    engineLimits.nodeLimit = askNumber("Batas node per langkah", engineLimits.nodeLimit);
+    engineLimits.maxDepth = (int)askNumber("Kedalaman maksimum", engineLimits.maxDepth);
+    engineLimits.threads = (int)askNumber("Jumlah thread", engineLimits.threads);
+    ponderEnabled = askNumber("Berpikir saat giliran lawan (1 = ya, 0 = tidak)", ponderEnabled)!=0;
+    if (engineLimits.threads<1) engineLimits.threads = 1;
+    if (engineLimits.threads>MAX_THREADS) engineLimits.threads = MAX_THREADS;
+    long long mb = askNumber("Ukuran tabel transposisi (MB)", ttSizeMb);
+    if (mb!=ttSizeMb) { if (ttResize(&mainTT, (size_t)mb)) ttSizeMb = mb; else printf("Memori tidak cukup, ukuran tetap %lld MB.\n", ttSizeMb); }
+    if (!engineLimits.moveTimeMs && !engineLimits.nodeLimit && !engineLimits.maxDepth) {
+        printf("Tanpa batas sama sekali komputer tidak akan selesai berpikir; waktu dikembalikan ke 1000 ms.\n");
+        engineLimits.moveTimeMs = 1000;
+    }
+}
+
 void menu() {
     int choice;
     char playerColor; // 'w' or 'b'
+    static Game game; // large (history buffer), keep it off the stack
     while (1) {
-        printf("=== CATUR ===\n1. Player vs Player\n2. Player vs Computer\n0. Keluar\nPilih mode: ");
+        printf("=== CATUR ===\n1. Player vs Player\n2. Player vs Computer\n3. Pengaturan komputer\n0. Keluar\nPilih mode: ");
         if (scanf("%d",&choice)!=1) { while(getchar()!='\n'); continue; }
         while(getchar()!='\n'); // consume newline
         if (choice==0) { printf("Terima kasih, keluar.\n"); break; }
-        initBoard();
+        if (choice==3) { engineSettingsMenu(); continue; }
+        initBoard(&game);
         // randomize colors
         if (choice==1) {
             if (rand()%2) { playerColor='w'; } else { playerColor='b'; }
             printf("PvP: Player A = %s, Player B = %s\n", (playerColor=='w')?"Putih":"Hitam", (playerColor=='w')?"Hitam":"Putih");
             // In PvP we don't track which player is "human" separately  both are human
-            userVsUserLoop();
+            userVsUserLoop(&game);
         } else if (choice==2) {
             // pick human color randomly
             if (rand()%2) playerColor='w'; else playerColor='b';
             printf("PvC: Kamu bermain sebagai %s\n", (playerColor=='w') ? "Putih" : "Hitam");
-            userVsComputerLoop(playerColor);
+            userVsComputerLoop(&game, playerColor);
         } else {
             printf("Pilihan salah!\n");
         }
     }
 }
 
-int main(){
+#ifdef CATUR_PERFT
+// separate build target: gcc -O2 -DCATUR_PERFT -o perft "catur long.c"
+int main(int argc, char **argv){
+    initBitboards(); initZobrist(); initEval();
+    return perftMain(argc, argv);
+}
+#else
+const char *statsJsonPath;  // --stats-json: where the statistics go at exit
+
+void writeStatsAtExit(void) {
+    FILE *f = fopen(statsJsonPath, "w");
+    if (!f) { fprintf(stderr, "Tidak bisa menulis statistik ke %s.\n", statsJsonPath); return; }
+    writeStatsJson(f); fclose(f);
+}
+
+// catur [--book file.bin] [--tb dir] [--stats-json file] [--quiet | --diff]
+//       [--uci | --selfplay options... | --pgn-check file | --analyze file.epd options... | --make-book in.pgn out.bin | --make-tb [dir]]
+int main(int argc, char **argv){
     srand((unsigned int)time(NULL));
+    initBitboards(); initZobrist(); initEval();
+    if (!initTablebases()) { fprintf(stderr, "Gagal mengalokasikan tabel akhir permainan.\n"); return 1; }
+    if (!ttResize(&mainTT, TT_DEFAULT_MB)) { fprintf(stderr, "Gagal mengalokasikan tabel transposisi.\n"); return 1; }
+    // options that apply to every mode, in any order
+    while (argc>1) {
+        if (argc>2 && strcmp(argv[1],"--book")==0) {
+            if (!bookOpen(&openingBook, argv[2])) fprintf(stderr, "Buku pembuka %s tidak bisa dibuka.\n", argv[2]);
+            argc -= 2; argv += 2;
+        } else if (argc>2 && strcmp(argv[1],"--tb")==0) {
+            if (!tbLoad4(argv[2])) fprintf(stderr, "Tidak ada tabel akhir permainan 4 bidak di %s.\n", argv[2]);
+            argc -= 2; argv += 2;
+        } else if (argc>2 && strcmp(argv[1],"--stats-json")==0) {
+            statsJsonPath = argv[2]; atexit(writeStatsAtExit);
+            argc -= 2; argv += 2;
+        } else if (strcmp(argv[1],"--quiet")==0) { renderMode = RENDER_QUIET; argc--; argv++; }
+        else if (strcmp(argv[1],"--diff")==0) { renderMode = RENDER_DIFF; atexit(resetScrollRegion); argc--; argv++; }
+        else break;
+    }
+    if (argc>1 && strcmp(argv[1],"--uci")==0) return uciLoop();
+    if (argc>1 && strcmp(argv[1],"--selfplay")==0) return selfPlayMain(argc-2, argv+2);
+    if (argc>1 && strcmp(argv[1],"--pgn-check")==0) return pgnReplayMain(argc-2, argv+2);
+    if (argc>1 && strcmp(argv[1],"--analyze")==0) return analyzeMain(argc-2, argv+2);
+    if (argc>1 && strcmp(argv[1],"--make-book")==0) return makeBookMain(argc-2, argv+2);
+    if (argc>1 && strcmp(argv[1],"--make-tb")==0) return makeTbMain(argc-2, argv+2);
+    engineLimits.threads = cpuCount() < MAX_THREADS ? cpuCount() : MAX_THREADS;
     menu();
     return 0;
 }
+#endif